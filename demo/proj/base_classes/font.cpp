@@ -1,9 +1,14 @@
 #include "font.h"
+#include "glyph_cache.h"
 #include "texture_atlas.h"
 #include "utility/sdf.h"
+#include "utility/msdf.h"
+#include "utility/parallel.h"
 #include "policies/resource.h"
+#include "policies/profiling.h"
 #include <glm/gtc/epsilon.hpp>
 #include <utfcpp/utf8.h>
+#include <algorithm>
 #define STB_TRUETYPE_IMPLEMENTATION
 #define STBTT_STATIC
 #include <stb_truetype.h>
@@ -12,75 +17,531 @@ using namespace code_policy;
 
 static_assert(sizeof(ubyte) == sizeof(unsigned char), "Platform uchar size not supported by STBTT");
 
+static uint16 unorm16(float v)
+{
+  return cast<uint16>(glm::round(glm::clamp(v, 0.f, 1.f) * 65535.f));
+}
+
 Font::CharData::CharData(float _adv, float _u1, float _v1, float _u2, float _v2, float _x1, float _x2, float _y1, float _y2)
-  : empty(glm::any(glm::epsilonEqual(vec2(_y2 - _y1, _x2 - _x1), vec2(0), std::numeric_limits<float>::epsilon() * 2)))
-  , adv(_adv), x1(_x1), x2(_x2), y1(_y1), y2(_y2)
-  , u1(_u1), u2(_u2), v1(_v1), v2(_v2)
+  : adv(_adv), x1(_x1), x2(_x2), y1(_y1), y2(_y2)
+  , u1(unorm16(_u1)), v1(unorm16(_v1)), u2(unorm16(_u2)), v2(unorm16(_v2))
+  , empty(glm::any(glm::epsilonEqual(vec2(_y2 - _y1, _x2 - _x1), vec2(0), std::numeric_limits<float>::epsilon() * 2)))
 { }
 
+vec4 Font::CharData::uv()const
+{
+  return vec4(u1, v1, u2, v2) / 65535.f;
+}
+
+struct Font::Source
+{
+  Source(vector<char> file_data, uint glyph_size, uint border_size, uint supersample_mult)
+    : file(move(file_data))
+    , border(border_size * supersample_mult)
+    , supersample(supersample_mult)
+  {
+    if(!stbtt_InitFont(&info, reinterpret_cast<unsigned char const*>(file.data()), 0))
+      CERROR("Error initializing freetype");
+
+    scale = stbtt_ScaleForPixelHeight(&info, glyph_size * supersample_mult);
+    s = 1. / (glyph_size * supersample_mult + border * 2);
+  }
+
+  vector<char> file;
+  stbtt_fontinfo info;
+  uint border, supersample;
+  float scale;
+  double s;
+};
+
+
+struct glyph {
+  glyph(uint _i, int _g, int _x1, int _x2, int _y1, int _y2, float _a, float _l, int b)
+    : i(_i), g(_g), x1(_x1 - b), x2(_x2 + b), y1(_y1 - b), y2(_y2 + b), a(_a), l(_l)
+  { }
+
+  bool empty()const { return x1 == x2; }
+
+  uint i;
+  int g, x1, x2, y1, y2;
+  float a, l;
+};
+
+static glyph measure(Font::Source const&src, uint c, int g)
+{
+  int a, l, x1, y1, x2, y2;
+  stbtt_GetGlyphHMetrics(&src.info, g, &a, &l);
+  stbtt_GetGlyphBitmapBox(&src.info, g, src.scale, src.scale, &x1, &y1, &x2, &y2);
+  Val adv = src.s * src.scale * a;
+  CASSERT(x2 >= x1 && y2 >= y1, "Negative glyph size");
+
+  if(x2 == x1 || y2 == y1)
+    return { c, g, 0, 0, 0, 0, float(adv), 0, 0 };
+
+  return { c, g, x1, x2, y1, y2, float(adv), src.scale * l, cast<int>(src.border) };
+}
+
+static glyph measure(Font::Source const&src, uint c)
+{
+  return measure(src, c, stbtt_FindGlyphIndex(&src.info, cast<int>(c)));
+}
+
+static uImage bitmap(Font::Source const&src, glyph const&g)
+{
+  Val border = src.border;
+  Val w = g.x2 - g.x1 - cast<int>(border) * 2
+      , h = g.y2 - g.y1 - cast<int>(border) * 2;
+
+  vector<ubyte> data(cast<size_t>(w) * cast<size_t>(h), 0);
+  stbtt_MakeGlyphBitmap(&src.info, data.data(), w, h, w, src.scale, src.scale, g.g);
+
+  Val _w = cast<uint>(w) + border * 2, _h = cast<uint>(h) + border * 2;
+  uImage img = { _w, _h, 1, vector<ubyte>( size_t(_w) * _h, 0 ) };
+  for(ptrdiff_t j=0; j<h; ++j)
+    std::copy(data.cbegin() + j * w, data.cbegin() + (j+1) * w, img.data.begin() + (j + border) * img.width + border);
+
+  return img;
+}
+
+static uImage render(Font::Source const&src, uImage const&img, SdfGenerator const&sdf)
+{
+  Val tex = sdf.generate({ img, 1, 1 }, src.supersample, src.border * 2);
+  return { tex.width(), tex.height(), 1, GLbind(tex).Save<ubyte>(1) };
+}
+
+static uImage msdf(Font::Source const&src, glyph const&g)
+{
+  stbtt_vertex *verts = nullptr;
+  Val n = stbtt_GetGlyphShape(&src.info, g.g, &verts);
+
+  GlyphShape shape;
+  vec2 at(0);
+  for(int i=0; i<n; ++i)
+  {
+    Val v = verts[i];
+    Val to = vec2(v.x, v.y);
+    switch(v.type)
+    {
+      case STBTT_vmove:  shape.contours.emplace_back(); break;
+      case STBTT_vline:  shape.contours.back().push_back({ { at, to }, 1 }); break;
+      case STBTT_vcurve: shape.contours.back().push_back({ { at, vec2(v.cx, v.cy), to }, 2 }); break;
+      case STBTT_vcubic: shape.contours.back().push_back({ { at, vec2(v.cx, v.cy), vec2(v.cx1, v.cy1), to }, 3 }); break;
+    }
+    at = to;
+  }
+  stbtt_FreeShape(&src.info, verts);
+
+  Val ss = src.supersample;
+  Val step = float(ss) / src.scale;
+  return MakeMsdf(shape, cast<uint>(g.x2 - g.x1) / ss, cast<uint>(g.y2 - g.y1) / ss, vec2(step, -step), vec2(g.x1, -g.y1) / src.scale, float(src.border * 2 / ss));
+}
+
+static Font::CharData makeCharData(Font::Source const&src, glyph const&g, vec4 const&c)
+{
+  Val s = src.s;
+  return { g.a, c.x, c.w, c.z, c.y, float(s * (-g.l + g.x1)), float(s * (-g.l + g.x2)), float(-s * g.y2), float(-s * g.y1) };
+}
+
+
+shared_ptr<const Font::Source> Font::MakeSource(string const&filename, uint glyph_size, uint border_size, uint supersample_mult)
+{
+  auto file = Resource::Load(filename);
+  if(file.empty())
+    CERROR("No font file "<<filename);
+
+  return MakeSource(move(file), glyph_size, border_size, supersample_mult);
+}
+
+shared_ptr<const Font::Source> Font::MakeSource(vector<char> file, uint glyph_size, uint border_size, uint supersample_mult)
+{
+  return make_shared<const Source>(move(file), glyph_size, border_size, supersample_mult);
+}
+
+Font::Font(unordered_map<uint, CharData> font_map, unordered_map<uint, unordered_map<uint, float>> kerning, double topline, double bottomline, shared_ptr<GLtex2d> tex, shared_ptr<const Source> source)
+  : m_topline(topline)
+  , m_bottomline(bottomline)
+  , m_tex(move(tex))
+  , m_pages(bmp_pages, absent)
+  , m_source(move(source))
+{
+  CASSERT(font_map.size() < absent, "Too many glyphs in font");
+
+  map<uint, CharData> sorted(font_map.cbegin(), font_map.cend());
+  vector<uint> page_glyphs(bmp_pages, 0);
+  for(Val i: sorted)
+    if(i.first < 0x10000)
+      ++page_glyphs[i.first >> page_bits];
+
+  m_glyphs.reserve(sorted.size());
+  for(Val i: sorted)
+  {
+    Val c = i.first;
+    Val idx = cast<uint16>(m_glyphs.size());
+    m_glyphs.emplace_back(i.second);
+
+    if(c < 0x10000 &&
+       page_glyphs[c >> page_bits] >= min_page_glyphs)
+    {
+      auto &page = m_pages[c >> page_bits];
+      if(page == absent)
+      {
+        page = cast<uint16>(m_slots.size() / page_size);
+        m_slots.resize(m_slots.size() + page_size, absent);
+      }
+
+      m_slots[page * page_size + (c & (page_size - 1))] = idx;
+      continue;
+    }
+
+    m_sparse_codes.emplace_back(c);
+    m_sparse_slots.emplace_back(idx);
+  }
+
+  vector<vector<pair<uint16, float>>> pairs(m_glyphs.size());
+  for(Val i: kerning)
+  {
+    Val s1 = slot(i.first);
+    if(s1 == absent)
+      continue;
+
+    for(Val j: i.second)
+    {
+      Val s2 = slot(j.first);
+      if(s2 != absent)
+        pairs[s1].emplace_back(s2, j.second);
+
+      Val a1 = i.first - ascii_first
+          , a2 = j.first - ascii_first;
+      if(a1 < ascii_size &&
+         a2 < ascii_size)
+      {
+        if(m_ascii_kern.empty())
+          m_ascii_kern.resize(ascii_size * ascii_size, 0);
+        m_ascii_kern[a1 * ascii_size + a2] = j.second;
+      }
+    }
+  }
+
+  m_kern_index.reserve(pairs.size() + 1);
+  m_kern_index.emplace_back(0);
+  for(auto &p: pairs)
+  {
+    std::sort(p.begin(), p.end(), [](Val l, Val r){ return l.first < r.first; });
+    for(Val k: p)
+    {
+      m_kern_second.emplace_back(k.first);
+      m_kern_value.emplace_back(k.second);
+    }
+    m_kern_index.emplace_back(cast<uint>(m_kern_second.size()));
+  }
+
+  indexKerning();
+}
+
+void Font::indexKerning()
+{
+  m_ascii_slotted = true;
+  for(uint c=ascii_first; c<ascii_first + ascii_size - 1; ++c)
+    m_ascii_slotted &= slot(c) != absent;
+
+  Val glyphs = m_glyphs.size();
+  m_kern_rows.assign(glyphs, no_row);
+  m_kern_dense.clear();
+  if(m_kern_index.size() != glyphs + 1)
+    return;
+
+  //a row costs a float per glyph, so it's only made where at least every 8th slot is a pair
+  for(size_t s=0; s<glyphs; ++s)
+  {
+    Val b = m_kern_index[s]
+        , e = m_kern_index[s + 1];
+    if(e - b < min_row_pairs ||
+       (e - b) * 8 < glyphs)
+      continue;
+
+    m_kern_rows[s] = cast<uint>(m_kern_dense.size());
+    m_kern_dense.resize(m_kern_dense.size() + glyphs, 0);
+    for(uint i=b; i<e; ++i)
+      m_kern_dense[m_kern_rows[s] + m_kern_second[i]] = m_kern_value[i];
+  }
+}
+
+uint16 Font::slot(uint c)const
+{
+  if((c >> page_bits) < m_pages.size())
+  {
+    Val page = m_pages[c >> page_bits];
+    if(page != absent)
+      return m_slots[page * page_size + (c & (page_size - 1))];
+  }
+
+  Val found = std::lower_bound(m_sparse_codes.cbegin(), m_sparse_codes.cend(), c);
+  if(found == m_sparse_codes.cend() || *found != c)
+    return absent;
+
+  return m_sparse_slots[cast<size_t>(found - m_sparse_codes.cbegin())];
+}
+
 Font::CharData const& Font::charData(uint c)const
 {
-  Val found = m_font_map.find(c);
-  if(found != m_font_map.cend())
-    return found->second;
+  Val s = slot(c);
+  if(s != absent)
+    return m_glyphs[s];
+
+  if(m_source)
+    return dynamicData(c);
 
   CASSERT(0, "No character "<<[c]{ string s; utf8::append(c, std::back_inserter(s)); return s; }()<<" code "<<c);
-  return m_font_map.cbegin()->second;
+  return m_glyphs.front();
 }
 
-bool Font::exists(uint c) const
+Font::CharData const& Font::dynamicData(uint c)const
 {
-  Val found = m_font_map.find(c);
+  Val found = m_dynamic.find(c);
+  if(found != m_dynamic.cend())
+  {
+    Val page = found->second.page;
+    if(page != CharData::atlas && page != CharData::pending)
+      GlyphCache::Get().Touch(page - 1u);
+    return found->second;
+  }
+
+  Val g = measure(*m_source, c);
+  auto d = makeCharData(*m_source, g, vec4(0));
+  d.page = g.empty() ? ubyte(CharData::atlas) : ubyte(CharData::pending);
 
-  return found != m_font_map.cend();
+  Val r = m_dynamic.emplace(c, d).first->second;
+  if(!g.empty())
+    GlyphCache::Get().Request(this, c);
+
+  return r;
+}
+
+uImage Font::rasterize(uint c)const
+{
+  static const SdfGenerator s_sdf;
+  return render(*m_source, bitmap(*m_source, measure(*m_source, c)), s_sdf);
+}
+
+bool Font::exists(uint c) const
+{
+  return slot(c) != absent ||
+      (m_source && stbtt_FindGlyphIndex(&m_source->info, cast<int>(c)));
 }
 
 float Font::kerning(uint c1, uint c2)const
 {
-  Val found = m_kerning.find(c1);
-  if(found == m_kerning.cend())
+  Val a1 = c1 - ascii_first
+      , a2 = c2 - ascii_first;
+  if(a1 < ascii_size &&
+     a2 < ascii_size &&
+     (m_ascii_slotted || !m_source))
+    return m_ascii_kern.empty() ? 0 : m_ascii_kern[a1 * ascii_size + a2];
+
+  //glyphs outside the atlas have no slot, their pairs come straight from the font in either position
+  Val s1 = slot(c1)
+      , s2 = slot(c2);
+  if(s1 == absent ||
+     s2 == absent)
+    return c1 && m_source ? float(m_source->s * m_source->scale * stbtt_GetCodepointKernAdvance(&m_source->info, cast<int>(c1), cast<int>(c2))) : 0;
+
+  Val row = m_kern_rows[s1];
+  if(row != no_row)
+    return m_kern_dense[row + s2];
+
+  Val begin = m_kern_second.cbegin() + m_kern_index[s1]
+      , end = m_kern_second.cbegin() + m_kern_index[s1 + 1u];
+  if(begin == end)
     return 0;
 
-  Val kern = found->second.find(c2);
-  if(kern == found->second.cend())
+  Val found = std::lower_bound(begin, end, s2);
+  if(found == end || *found != s2)
     return 0;
 
-  return kern->second;
+  return m_kern_value[cast<size_t>(found - m_kern_second.cbegin())];
 }
 
 
-struct glyph {
-  glyph(uint _i, int _x1, int _x2, int _y1, int _y2, float _a, float _l, int b, unordered_map<uint, float> _kern)
-    : i(_i), x1(_x1 - b), x2(_x2 + b), y1(_y1 - b), y2(_y2 + b), a(_a), l(_l)
-    , kern(move(_kern))
-  { }
+//walks the kern and GPOS pair tables instead of querying every pair; mirrors stb's lookup order, first matching subtable wins
+static unordered_map<uint, unordered_map<uint, float>> kerningTable(Font::Source const&src, unordered_map<uint, int> const&glyph_ids)
+{
+  unordered_map<int, vector<uint>> codes;
+  for(Val i: glyph_ids)
+    codes[i.second].emplace_back(i.first);
 
-  uint i;
-  int x1, x2, y1, y2;
-  float a, l;
-  unordered_map<uint, float> kern;
-};
+  map<pair<int, int>, int> pairs;
+  Val info = src.info;
 
-unordered_map<string, Font> code_policy::MakeFonts(map<string, string> font_descriptions, uint glyph_size, uint border_size, uint supersample_mult)
+  if(info.gpos)
+  {
+    Val data = info.data + info.gpos;
+    vector<stbtt_uint8*> subtables;
+    if(ttUSHORT(data) == 1 && ttUSHORT(data + 2) == 0)
+    {
+      Val lookups = data + ttUSHORT(data + 8);
+      for(int i=0; i<ttUSHORT(lookups); ++i)
+      {
+        Val lookup = lookups + ttUSHORT(lookups + 2 + 2 * i);
+        if(ttUSHORT(lookup) == 2)
+          for(int j=0; j<ttUSHORT(lookup + 4); ++j)
+            subtables.emplace_back(lookup + ttUSHORT(lookup + 6 + 2 * j));
+      }
+    }
+
+    struct classes {
+      unordered_map<int, int> of;
+      vector<vector<int>> members;
+    };
+    unordered_map<stbtt_uint8*, classes> class_cache;
+    Val classesOf = [&](stbtt_uint8 *table)->classes const& {
+      Val found = class_cache.find(table);
+      if(found != class_cache.cend())
+        return found->second;
+
+      auto &c = class_cache[table];
+      c.members.resize(ttUSHORT(table + 14));
+      for(Val i: codes)
+      {
+        Val k = stbtt__GetGlyphClass(table + ttUSHORT(table + 10), i.first);
+        if(k >= 0 && k < cast<int>(c.members.size()))
+        {
+          c.of.emplace(i.first, k);
+          c.members[cast<size_t>(k)].emplace_back(i.first);
+        }
+      }
+      return c;
+    };
+
+    for(Val first: codes)
+    {
+      Val g1 = first.first;
+      set<int> resolved;
+      vector<classes const*> class_hits;
+      Val blocked = [&](int g2){
+        return resolved.count(g2) || std::any_of(class_hits.cbegin(), class_hits.cend(), [g2](Val c){ return c->of.count(g2); });
+      };
+
+      for(Val table: subtables)
+      {
+        Val coverage = stbtt__GetCoverageIndex(table + ttUSHORT(table + 2), g1);
+        if(coverage < 0)
+          continue;
+
+        if(ttUSHORT(table + 4) != 4 || ttUSHORT(table + 6) != 0)
+          break;
+
+        if(ttUSHORT(table) == 1)
+        {
+          Val set = table + ttUSHORT(table + 10 + 2 * coverage);
+          for(int i=0; i<ttUSHORT(set); ++i)
+          {
+            Val g2 = cast<int>(ttUSHORT(set + 2 + 4 * i));
+            if(!codes.count(g2) || blocked(g2))
+              continue;
+
+            pairs[{ g1, g2 }] += ttSHORT(set + 4 + 4 * i);
+            resolved.emplace(g2);
+          }
+        }
+        else if(ttUSHORT(table) == 2)
+        {
+          Val class1 = stbtt__GetGlyphClass(table + ttUSHORT(table + 8), g1);
+          if(class1 < 0 || class1 >= ttUSHORT(table + 12))
+            continue;
+
+          Val c = classesOf(table);
+          Val row = table + 16 + 2 * class1 * ttUSHORT(table + 14);
+          for(size_t k=0; k<c.members.size(); ++k)
+            if(Val v = ttSHORT(row + 2 * k))
+              for(Val g2: c.members[k])
+                if(!blocked(g2))
+                  pairs[{ g1, g2 }] += v;
+
+          class_hits.emplace_back(&c);
+        }
+      }
+    }
+  }
+
+  if(info.kern)
+  {
+    Val data = info.data + info.kern;
+    if(ttUSHORT(data + 2) >= 1 && ttUSHORT(data + 8) == 1)
+      for(int i=0; i<ttUSHORT(data + 10); ++i)
+      {
+        Val g1 = cast<int>(ttUSHORT(data + 18 + 6 * i))
+            , g2 = cast<int>(ttUSHORT(data + 20 + 6 * i));
+        if(codes.count(g1) && codes.count(g2))
+          pairs[{ g1, g2 }] += ttSHORT(data + 22 + 6 * i);
+      }
+  }
+
+  unordered_map<uint, unordered_map<uint, float>> kerning;
+  for(Val p: pairs)
+    if(p.second != 0)
+      for(Val c1: codes[p.first.first])
+        for(Val c2: codes[p.first.second])
+          kerning[c1].emplace(c2, src.s * src.scale * p.second);
+
+  return kerning;
+}
+
+static pair<unordered_map<uint, Vtex>, map<uint, uImage>> batchedAtlas(map<uint, uImage> const&images, uint scale, uint border, uint max_size)
 {
-  Val border = border_size * supersample_mult;
-  Val s = 1. / (glyph_size * supersample_mult + border * 2);
-  Val sdf = SdfGenerator{};
-  map<string, vector<glyph>> fonts_map;
+  CAUTOTIMER_SINGLE(batched_sdf)
+  Val aligned = [scale](uint v){ return (v + scale - 1) / scale * scale; };
+
+  uint64 area = 0;
+  for(Val i: images)
+    area += uint64(aligned(i.second.width) + border * 2) * (aligned(i.second.height) + border * 2);
+  if(area > uint64(max_size) * max_size)
+    return {};
+
+  map<uint, uvec2> sizes;
+  map<uint, uImage> bitmaps;
+  for(Val i: images)
+  {
+    Val img = i.second;
+    sizes.emplace(i.first, uvec2(img.width, img.height));
+
+    Val w = aligned(img.width)
+        , h = aligned(img.height);
+    uImage a = { w, h, 1, vector<ubyte>(size_t(w) * h, 0) };
+    for(uint j=0; j<img.height; ++j)
+      std::copy(img.data.cbegin() + j * img.width, img.data.cbegin() + (j + 1) * img.width, a.data.begin() + j * w);
+    bitmaps.emplace(i.first, move(a));
+  }
+
+  auto p = MakeAtlas(max_size, max_size, 1, move(bitmaps), border);
+  if(!p.second.empty())
+    return {};
+  if(p.first.empty())
+    return p;
+
+  Val coverage = p.first.begin()->second.tex;
+  Val size = vec2(coverage->width(), coverage->height());
+  Val sdf = make_shared<GLtex2d>(SdfGenerator{}.generate(*coverage, scale, border * 2));
+  Val s = float(scale);
+
+  for(auto &i: p.first)
+  {
+    Val at = vec2(i.second.coord) * size - 0.5f;
+    Val wh = vec2(sizes[i.first]);
+    i.second = { (vec4(at, at + wh) / s + vec4(0.5, 0.5, -0.5, -0.5)) / vec4(size, size) * s, sdf };
+  }
+
+  return p;
+}
+
+unordered_map<string, Font> code_policy::MakeFonts(map<string, string> font_descriptions, uint glyph_size, uint border_size, uint supersample_mult, SdfBackend sdf)
+{
+  map<string, pair<shared_ptr<const Font::Source>, vector<pair<glyph, unordered_map<uint, float>>>>> fonts_map;
   map<uint, uImage> glyph_images;
+  vector<pair<Font::Source const*, glyph>> rasterize;
 
   for(Val font: font_descriptions)
   {
-    Val font_file = Resource::Load(font.first);
-    if(font_file.empty())
-      CERROR("No font file "<<font.first);
-
-    Val font_info = [&]{
-      stbtt_fontinfo info;
-      if(!stbtt_InitFont(&info, reinterpret_cast<unsigned char const*>(font_file.data()), 0))
-        CERROR("Error initializing freetype");
-      return info;
-    }();
+    Val src = Font::MakeSource(font.first, glyph_size, border_size, supersample_mult);
 
     Val alphabet = [&]{
       set<uint> a;
@@ -90,79 +551,113 @@ unordered_map<string, Font> code_policy::MakeFonts(map<string, string> font_desc
       return a;
     }();
 
-    Val scale = stbtt_ScaleForPixelHeight(&font_info, glyph_size * supersample_mult);
+    unordered_map<uint, int> glyph_ids;
+    for(Val i: alphabet)
+      glyph_ids.emplace(i, stbtt_FindGlyphIndex(&src->info, cast<int>(i)));
+
+    auto kerning = kerningTable(*src, glyph_ids);
 
-    vector<glyph> glyph_set;
+    vector<pair<glyph, unordered_map<uint, float>>> glyph_set;
     for(Val i: alphabet)
     {
-      Val g = stbtt_FindGlyphIndex(&font_info, cast<int>(i));
-      int a, l, x1, y1, x2, y2;
-      stbtt_GetGlyphHMetrics(&font_info, g, &a, &l);
-      stbtt_GetGlyphBitmapBox(&font_info, g, scale, scale, &x1, &y1, &x2, &y2);
-      Val w = x2 - x1, h = y2 - y1;
-      Val adv = s * scale * a;
-      CASSERT(w >= 0 && h >= 0, "Negative glyph size");
-
-      if(w == 0 || h == 0)
+      Val g = measure(*src, i, glyph_ids[i]);
+      if(g.empty())
       {
-        glyph_set.emplace_back(i, 0, 0, 0, 0, adv, 0, 0, unordered_map<uint, float>{ });
+        glyph_set.emplace_back(g, unordered_map<uint, float>{ });
         continue;
       }
 
-      vector<ubyte> data(cast<size_t>(w) * cast<size_t>(h), 0);
-      stbtt_MakeGlyphBitmap(&font_info, data.data(), cast<int>(w), cast<int>(h), cast<int>(w), scale, scale, g);
+      if(glyph_images.emplace(i, uImage{ }).second)
+        rasterize.emplace_back(src.get(), g);
 
-      Val _w = cast<uint>(w) + border * 2, _h = cast<uint>(h) + border * 2;
-      uImage img = { _w, _h, 1, vector<ubyte>( size_t(_w) * _h, 0 ) };
-      for(ptrdiff_t j=0; j<h; ++j)
-        std::copy(data.cbegin() + j * w, data.cbegin() + (j+1) * w, img.data.begin() + (j + border) * img.width + border);
+      glyph_set.emplace_back(g, move(kerning[i]));
+    }
 
-      Val tex = sdf.generate({ img, 1, 1 }, supersample_mult, border * 2);
-      img = { tex.width(), tex.height(), 1, GLbind(tex).Save<ubyte>(1) };
+    fonts_map.emplace(font.first, make_pair(src, move(glyph_set)));
+  }
 
-      unordered_map<uint, float> kern;
-      for(Val j: alphabet)
-      {
-        Val k = stbtt_GetGlyphKernAdvance(&font_info, g, stbtt_FindGlyphIndex(&font_info, cast<int>(j)));
-        if(k != 0)
-          kern.emplace(j, s * scale * k);
-      }
+  vector<uImage> bitmaps(rasterize.size());
+  ParallelFor(rasterize.size(), [&](size_t i){
+    Val r = rasterize[i];
+    bitmaps[i] = sdf == SdfBackend::Msdf ? msdf(*r.first, r.second) : bitmap(*r.first, r.second);
+  });
+  for(size_t i=0; i<rasterize.size(); ++i)
+    glyph_images[rasterize[i].second.i] = move(bitmaps[i]);
+
+  Val max_tex_size = cast<uint>(GLState::Iconst<GL_MAX_TEXTURE_SIZE>());
+  Val p = [&]{
+    if(sdf == SdfBackend::Msdf)
+      return MakeAtlas(max_tex_size, max_tex_size, 3, move(glyph_images));
 
-      glyph_images.emplace(i, move(img));
-      glyph_set.emplace_back(i, x1, x2, y1, y2, adv, scale * l, border, move(kern));
+    if(sdf == SdfBackend::Batched)
+    {
+      auto batched = batchedAtlas(glyph_images, supersample_mult, border_size * supersample_mult, max_tex_size);
+      if(!batched.first.empty())
+        return batched;
+
+      if(!glyph_images.empty())
+        CINFO("Charset doesn't fit the batched sdf coverage sheet, generating glyphs one by one");
     }
 
-    fonts_map.emplace(font.first, move(glyph_set));
-  }
+    if(sdf == SdfBackend::Cpu)
+    {
+      CAUTOTIMER_SINGLE(cpu_sdf)
+      vector<uImage> bitmaps;
+      for(auto &i: glyph_images)
+        bitmaps.emplace_back(move(i.second));
 
-  Val max_tex_size = cast<uint>(GLState::Iconst<GL_MAX_TEXTURE_SIZE>());
-  Val p = MakeAtlas(max_tex_size, max_tex_size, 1, move(glyph_images));
-  if(!p.second.empty())
-    CERROR("Sdf atlas is too big; reduce size or implement batching by atlas");
+      auto fields = SdfGenerator::generate(bitmaps, supersample_mult, border_size * supersample_mult * 2);
+      auto field = fields.begin();
+      for(auto &i: glyph_images)
+        i.second = move(*field++);
+    }
+    else if(!glyph_images.empty())
+    {
+      CAUTOTIMER_SINGLE(gl_sdf)
+      Val generator = SdfGenerator{};
+      Val src = fonts_map.cbegin()->second.first;
+      for(auto &i: glyph_images)
+        i.second = render(*src, i.second, generator);
+    }
+
+    return MakeAtlas(max_tex_size, max_tex_size, 1, move(glyph_images));
+  }();
 
   Val atlas = p.first;
-  Val texture = atlas.begin()->second.tex;
+  Val on_demand = p.second;
+  if(!on_demand.empty())
+    CINFO(on_demand.size()<<" glyphs don't fit the sdf atlas and will be loaded on demand");
+
+  Val texture = atlas.empty() ? nullptr : atlas.begin()->second.tex;
 
   unordered_map<string, Font> font_objects;
   for(Val font: fonts_map)
   {
+    Val src = font.second.first;
     unordered_map<uint, unordered_map<uint, float>> kerning;
     unordered_map<uint, Font::CharData> font_obj;
     double topline = 0, bottomline = 0;
-    for(Val g: font.second)
+    bool in_atlas = false;
+    for(Val i: font.second.second)
     {
-      Val found = atlas.find(g.i);
-      Val c = found != atlas.cend() ? found->second.coord : vec4(0);
-      Val y1 = -s * g.y2
-          , y2 = -s * g.y1;
+      Val g = i.first;
+      Val y1 = -src->s * g.y2
+          , y2 = -src->s * g.y1;
       topline = glm::max(topline, y2);
       bottomline = glm::min(bottomline, y1);
-      font_obj.emplace(g.i, Font::CharData(g.a, c.x, c.w, c.z, c.y, s * (-g.l + g.x1), s * (-g.l + g.x2), y1, y2));
-      if(!g.kern.empty())
-        kerning.emplace(g.i, g.kern);
+
+      if(on_demand.count(g.i))
+        continue;
+
+      Val found = atlas.find(g.i);
+      in_atlas |= found != atlas.cend();
+      Val c = found != atlas.cend() ? found->second.coord : vec4(0);
+      font_obj.emplace(g.i, makeCharData(*src, g, c));
+      if(!i.second.empty())
+        kerning.emplace(g.i, i.second);
     }
 
-    font_objects[font.first] = { font_obj, kerning, topline, bottomline, texture };
+    font_objects[font.first] = { font_obj, kerning, topline, bottomline, in_atlas ? texture : nullptr, src };
   }
 
   return font_objects;
@@ -10,29 +10,35 @@ namespace code_policy
 struct Font
 {
   friend struct GUI::FontManager;
+  friend struct GlyphCache;
+  struct Source;
 
-  template<class A> void serialize(A &a) { a(m_topline, m_bottomline, m_font_map, m_kerning); }
+  template<class A> void serialize(A &a) { a(m_topline, m_bottomline, m_glyphs, m_pages, m_slots, m_sparse_codes, m_sparse_slots, m_kern_index, m_kern_second, m_kern_value, m_ascii_kern); }
 
   struct CharData {
-    template<class A> void serialize(A &a) { a(empty, adv, x1, x2, y1, y2, u1, u2, v1, v2); }
+    template<class A> void serialize(A &a) { a(adv, x1, x2, y1, y2, u1, v1, u2, v2, empty); }
 
     CharData() = default;
     CharData(float, float, float, float, float, float, float, float, float);
 
+    enum : ubyte { atlas = 0, pending = 0xff };
+
+    vec4 uv()const;
+
+    float adv, x1, x2, y1, y2;
+    uint16 u1, v1, u2, v2;
     bool empty;
-    float adv, x1, x2, y1, y2, u1, u2, v1, v2;
+    ubyte page = atlas; //dynamic glyph cache page + 1
   };
 
   Font() = default;
-  Font(unordered_map<uint, CharData> font_map, unordered_map<uint, unordered_map<uint, float>> kerning, double topline, double bottomline, shared_ptr<GLtex2d> tex)
-    : m_topline(topline)
-    , m_bottomline(bottomline)
-    , m_tex(move(tex))
-    , m_font_map(move(font_map))
-    , m_kerning(move(kerning))
-  { }
-
-  Val tex()const          { return *m_tex;       }
+  Font(unordered_map<uint, CharData> font_map, unordered_map<uint, unordered_map<uint, float>> kerning, double topline, double bottomline, shared_ptr<GLtex2d> tex, shared_ptr<const Source> source=nullptr);
+
+  static shared_ptr<const Source> MakeSource(string const&filename, uint glyph_size, uint border_size, uint supersample_mult);
+  static shared_ptr<const Source> MakeSource(vector<char> file, uint glyph_size, uint border_size, uint supersample_mult);
+
+  GLtex2d const* tex()const { return m_tex.get(); } //null when every glyph comes from the GlyphCache
+  bool msdf()const        { return m_tex && m_tex->stats().channels == 3; }
   float topline()const    { return m_topline;    }
   float bottomline()const { return m_bottomline; }
   bool exists(uint c)const;
@@ -40,13 +46,38 @@ struct Font
   Font::CharData const& charData(uint c)const;
 
 private:
+  enum : uint { page_bits = 7, page_size = 1 << page_bits, bmp_pages = 0x10000 >> page_bits, min_page_glyphs = 8,
+                ascii_first = 0x20, ascii_size = 0x60 };
+  enum : uint16 { absent = 0xffff };
+  enum : uint { no_row = ~0u, min_row_pairs = 16 };
+  uint16 slot(uint c)const;
+  void indexKerning();
+  CharData const& dynamicData(uint c)const;
+  uImage rasterize(uint c)const;
+
   float m_topline, m_bottomline;
   shared_ptr<GLtex2d> m_tex;
-  unordered_map<uint, CharData> m_font_map;
-  unordered_map<uint, unordered_map<uint, float>> m_kerning;
+  vector<CharData> m_glyphs;
+  vector<uint16> m_pages, m_slots;
+  vector<uint> m_sparse_codes;
+  vector<uint16> m_sparse_slots;
+  vector<uint> m_kern_index;
+  vector<uint16> m_kern_second;
+  vector<float> m_kern_value, m_ascii_kern;
+  vector<uint> m_kern_rows; //first glyphs with many pairs get a dense row over all slots, derived from the ranges
+  vector<float> m_kern_dense;
+  bool m_ascii_slotted = false; //the ascii table is only complete when no printable ascii glyph is loaded on demand
+  shared_ptr<const Source> m_source;
+  mutable unordered_map<uint, CharData> m_dynamic;
 };
+static_assert(sizeof(Font::CharData) <= 32, "CharData should fit half a cache line");
+
 
+//Msdf builds a three channel atlas straight from glyph outlines, glyph_size ~20 with no supersampling is as crisp as a 28px sdf
+//Batched packs supersampled coverage into a single max texture size sheet, so it holds 1/supersample_mult^2 of a regular atlas
+//(a few hundred glyphs at 16x) and the generator needs three more sheets of that size; larger charsets fall back to PerGlyph
+enum class SdfBackend { PerGlyph, Batched, Cpu, Msdf };
 
-unordered_map<string, Font> MakeFonts(map<string, string> font_descriptions, uint glyph_size, uint border_size, uint supersample_mult);
+unordered_map<string, Font> MakeFonts(map<string, string> font_descriptions, uint glyph_size, uint border_size, uint supersample_mult, SdfBackend sdf=SdfBackend::PerGlyph);
 
 }
@@ -98,7 +98,7 @@ struct GLbindingBuffer : GLbinding<GLbuffer<m_type>>
   }
 
   void UpdateBuffer(void const*data, size_t size, size_t offset) {
-    GLCHECK(glBufferSubData(m_type, offset, size, data));
+    GLCHECK(glBufferSubData(m_type, cast<GLintptr>(offset), cast<GLsizeiptr>(size), data));
   }
 
   Mapping MapBuffer(GLenum ACCESS) {
@@ -126,6 +126,10 @@ struct GLbindingVao : GLbinding<GLvao>
     GLCHECK(glDrawElements(MODE, cast<GLsizei>(num), type, nullptr));
   }
 
+  void DrawArrays(uint first, uint num, GLenum MODE=GL_TRIANGLES)const {
+    GLCHECK(glDrawArrays(MODE, cast<GLint>(first), cast<GLsizei>(num)));
+  }
+
   template<class T>void DrawOffset(T num, T offset, GLenum MODE=GL_TRIANGLES)const {
     GLCHECK(glDrawElements(MODE, cast<GLsizei>(num), getGlType<T>(), reinterpret_cast<void*>(cast<intptr_t>(offset * sizeof(T)))));
   }
@@ -135,6 +139,16 @@ struct GLbindingVao : GLbinding<GLvao>
     GLCHECK(glEnableVertexAttribArray(idx));
     GLCHECK(glVertexAttribPointer(idx, size, TYPE, NORMALIZED, stride, first));
   }
+
+  void AttribIFormat(GLbindingBuffer<GL_ARRAY_BUFFER> const&, GLuint idx, GLint size, GLenum TYPE=GL_UNSIGNED_INT, GLsizei stride=0, void const*first=nullptr) {
+    CASSERT((size > 0) && (size < 5), "Attribute size only range from 1 to 4");
+    GLCHECK(glEnableVertexAttribArray(idx));
+    GLCHECK(glVertexAttribIPointer(idx, size, TYPE, stride, first));
+  }
+
+  void AttribDisable(GLuint idx) {
+    GLCHECK(glDisableVertexAttribArray(idx));
+  }
 };
 inline GLbindingVao GLbind(GLvao const&o) { return { o }; }
 
@@ -37,9 +37,13 @@ struct GLbindingShader : GLbinding<GLshader>
   void Uniform(char const*name, mat4x3 const&m) { GLCHECK(glUniformMatrix4x3fv(r_shader.GetUniform(name), 1, GL_FALSE, glm::value_ptr(m)));                          }
   void Uniform(char const*name, vector<int> const&u)   { GLCHECK(glUniform1iv(r_shader.GetUniform(name), u.size(), u.data()));                                       }
   void Uniform(char const*name, vector<float> const&u) { GLCHECK(glUniform1fv(r_shader.GetUniform(name), u.size(), u.data()));                                       }
-  void Uniform(char const*name, vector<vec2> const&u)  { GLCHECK(glUniform2fv(r_shader.GetUniform(name), u.size() * 2, reinterpret_cast<GLfloat const*>(u.data()))); }
-  void Uniform(char const*name, vector<vec3> const&u)  { GLCHECK(glUniform3fv(r_shader.GetUniform(name), u.size() * 3, reinterpret_cast<GLfloat const*>(u.data()))); }
-  void Uniform(char const*name, vector<vec4> const&u)  { GLCHECK(glUniform4fv(r_shader.GetUniform(name), u.size() * 4, reinterpret_cast<GLfloat const*>(u.data()))); }
+  void Uniform(char const*name, vector<vec2> const&u)  { GLCHECK(glUniform2fv(r_shader.GetUniform(name), u.size(), reinterpret_cast<GLfloat const*>(u.data())));     }
+  void Uniform(char const*name, vector<vec3> const&u)  { GLCHECK(glUniform3fv(r_shader.GetUniform(name), u.size(), reinterpret_cast<GLfloat const*>(u.data())));     }
+  void Uniform(char const*name, vector<vec4> const&u)  { GLCHECK(glUniform4fv(r_shader.GetUniform(name), u.size(), reinterpret_cast<GLfloat const*>(u.data())));     }
+  void UniformBlock(char const*name, uint binding) {
+    Val idx = GLCHECK_RET(glGetUniformBlockIndex(r_shader.obj(), name));
+    GLCHECK(glUniformBlockBinding(r_shader.obj(), idx, binding));
+  }
   template<class T, class...P> void Uniforms(char const*name, T value, P &&...p) {
     this->Uniform(name, value);
     this->Uniforms(forward<P>(p)...);
@@ -124,6 +124,33 @@ template GLtex2d::GLtex(uImage const&, uint, uint);
 template GLtex2d::GLtex(fImage const&, uint, uint);
 
 
+GLtex2dArray::GLtex(uint width, uint height, uint layers, uint channels, GLenum PRECISION)
+  : m_stats({ width, height, channels, PRECISION })
+  , m_layers(layers)
+{
+  checkParameters(width, height, 4);
+  auto b = GLbind(*this);
+  GLCHECK(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, getFormat(channels, PRECISION), cast<GLsizei>(width), cast<GLsizei>(height), cast<GLsizei>(layers), 0, getChannelsName(channels), GL_UNSIGNED_BYTE, nullptr));
+  b.Parameters(GL_TEXTURE_MIN_FILTER, GL_LINEAR, GL_TEXTURE_MAG_FILTER, GL_LINEAR,
+               GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void GLtex2dArrayBinding::Update(uint layer, uint x, uint y, uImage const&img, uint alignment)
+{
+  CASSERT(x + img.width <= r_stats.width && y + img.height <= r_stats.height, "Texture update out of bounds");
+  CASSERT(img.channels == r_stats.channels, "Texture update channel mismatch");
+  GLCHECK(glPixelStorei(GL_UNPACK_ALIGNMENT, cast<GLint>(alignment)));
+  GLCHECK(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, cast<GLint>(x), cast<GLint>(y), cast<GLint>(layer), cast<GLsizei>(img.width), cast<GLsizei>(img.height), 1, getChannelsName(img.channels), GL_UNSIGNED_BYTE, img.data.data()));
+}
+
+
+GLtexBuffer::GLtex(GLenum PRECISION)
+{
+  auto b = GLbind(*this, TextureControl::m_bound_unit);
+  GLbind(m_buffer).AllocateBuffer(nullptr, 0, GL_DYNAMIC_DRAW);
+  GLCHECK(glTexBuffer(GL_TEXTURE_BUFFER, PRECISION, m_buffer.obj()));
+}
+
 GLtexCube::GLtex(uint width, uint height, uint channels, GLenum PRECISION, array<void const*, 6> data, GLenum FORMAT, GLenum TYPE, uint alignment)
   : m_stats({ width, height, channels, PRECISION })
 {
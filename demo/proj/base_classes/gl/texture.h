@@ -88,6 +88,41 @@ private:
   mutable GLtexStats m_stats;
 };
 
+using GLtex2dArray = GLtex<GL_TEXTURE_2D_ARRAY>;
+
+template<>
+struct GLtex<GL_TEXTURE_2D_ARRAY> : GLobject<TexturePolicy>
+{
+  friend struct GLbinding<GLtex2dArray>;
+
+  GLtex(uint width, uint height, uint layers, uint channels, GLenum PRECISION=GL_BYTE);
+
+  Val stats()const   { return m_stats;        }
+  uint width()const  { return m_stats.width;  }
+  uint height()const { return m_stats.height; }
+  uint layers()const { return m_layers;       }
+
+private:
+  mutable GLtexStats m_stats;
+  uint m_layers;
+};
+
+using GLtexBuffer = GLtex<GL_TEXTURE_BUFFER>;
+
+template<>
+struct GLtex<GL_TEXTURE_BUFFER> : GLobject<TexturePolicy>
+{
+  friend struct GLbinding<GLtexBuffer>;
+
+  GLtex(GLenum PRECISION);
+
+  Val buffer()const { return m_buffer; }
+
+private:
+  GLbuffer<GL_TEXTURE_BUFFER> m_buffer;
+  mutable GLtexStats m_stats;
+};
+
 template<GLenum m_type>
 struct GLbinding<GLtex<m_type>>
 {
@@ -146,6 +181,17 @@ struct GLtexCubeBinding : GLbinding<GLtexCube>
 inline GLtexCubeBinding GLbind(GLtexCube const&t, GLuint unit) { return { t, unit };                         }
 inline GLtexCubeBinding GLbind(GLtexCube const&t)              { return { t, TextureControl::m_bound_unit }; }
 
+struct GLtex2dArrayBinding : GLbinding<GLtex2dArray>
+{
+  using GLbinding<GLtex2dArray>::GLbinding;
+
+  void Update(uint layer, uint x, uint y, uImage const&img, uint alignment=1);
+};
+inline GLtex2dArrayBinding GLbind(GLtex2dArray const&t, GLuint unit) { return { t, unit };                         }
+inline GLtex2dArrayBinding GLbind(GLtex2dArray const&t)              { return { t, TextureControl::m_bound_unit }; }
+
+inline GLbinding<GLtexBuffer> GLbind(GLtexBuffer const&t, GLuint unit) { return { t, unit }; }
+
 
 struct GLfbo : GLobject<FboPolicy>
 {
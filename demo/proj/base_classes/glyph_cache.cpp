@@ -0,0 +1,175 @@
+#include "glyph_cache.h"
+#include "font.h"
+#include <algorithm>
+
+using namespace code_policy;
+
+GlyphCache& GlyphCache::Get()
+{
+  static GlyphCache s_cache;
+  return s_cache;
+}
+
+void GlyphCache::Request(Font const*font, uint c)
+{
+  m_pending.emplace_back(font, c);
+}
+
+bool GlyphCache::Page::Allocate(uvec2 size, uvec2 &at)
+{
+  uint best_y = page_size, best_i = cast<uint>(skyline.size());
+
+  for(uint i=0; i<skyline.size(); ++i)
+  {
+    Val x = skyline[i].x;
+    if(x + size.x > page_size)
+      break;
+
+    uint y = 0, left = size.x;
+    for(uint j=i; left > 0; ++j)
+    {
+      y = glm::max(y, skyline[j].y);
+      left -= glm::min(left, skyline[j].z);
+    }
+
+    if(y + size.y <= page_size &&
+       y < best_y)
+    {
+      best_y = y;
+      best_i = i;
+    }
+  }
+
+  if(best_i == skyline.size())
+    return false;
+
+  at = uvec2(skyline[best_i].x, best_y);
+  Val end = at.x + size.x;
+  skyline.insert(skyline.cbegin() + best_i, uvec3(at.x, best_y + size.y, size.x));
+
+  for(auto i=best_i + 1; i<skyline.size();)
+  {
+    auto &n = skyline[i];
+    if(n.x >= end)
+      break;
+
+    Val overlap = end - n.x;
+    if(n.z <= overlap)
+    {
+      skyline.erase(skyline.cbegin() + i);
+      continue;
+    }
+
+    n.x += overlap;
+    n.z -= overlap;
+    break;
+  }
+
+  for(uint i=1; i<skyline.size();)
+    if(skyline[i - 1].y == skyline[i].y)
+    {
+      skyline[i - 1].z += skyline[i].z;
+      skyline.erase(skyline.cbegin() + i);
+    }
+    else
+      ++i;
+
+  return true;
+}
+
+void GlyphCache::Page::Clear()
+{
+  skyline = { uvec3(0, 0, page_size) };
+  glyphs.clear();
+}
+
+bool GlyphCache::allocate(uvec2 size, uvec2 &at, uint &page)
+{
+  for(uint i=0; i<m_pages.size(); ++i)
+    if(m_pages[i].Allocate(size, at))
+    {
+      page = i;
+      m_pages[i].used = m_frame;
+      return true;
+    }
+
+  Val lru = std::min_element(m_pages.begin(), m_pages.end(), [](Val l, Val r){ return l.used < r.used; });
+  if(lru->used == m_frame)
+    return false;
+
+  page = cast<uint>(lru - m_pages.begin());
+  for(Val i: lru->glyphs)
+  {
+    Val found = i.first->m_dynamic.find(i.second);
+    if(found != i.first->m_dynamic.cend() &&
+       found->second.page == page + 1)
+      i.first->m_dynamic.erase(found);
+  }
+  lru->Clear();
+  lru->used = m_frame;
+  ++m_epoch;
+
+  return lru->Allocate(size, at);
+}
+
+void GlyphCache::Update()
+{
+  if(!m_pending.empty())
+  {
+    GLint viewport[4];
+    GLCHECK(glGetIntegerv(GL_VIEWPORT, viewport));
+    Val fbo = StateControl<FboPolicy>::m_bound_object;
+
+    if(!m_tex)
+      m_tex = make_unique<GLtex2dArray>(page_size, page_size, pages, 1);
+
+    uint loaded = 0;
+    while(!m_pending.empty() && loaded < budget)
+    {
+      Val font = m_pending.front().first;
+      Val c = m_pending.front().second;
+      Val found = font->m_dynamic.find(c);
+      if(found == font->m_dynamic.cend() ||
+         found->second.page != Font::CharData::pending)
+      {
+        m_pending.pop_front();
+        continue;
+      }
+
+      Val img = font->rasterize(c);
+      Val size = uvec2(img.width, img.height) + uvec2(padding);
+      CASSERT(size.x <= page_size && size.y <= page_size, "Glyph is larger than a cache page");
+
+      uvec2 at;
+      uint page;
+      if(size.x > page_size || size.y > page_size)
+        found->second.page = Font::CharData::atlas;
+      else if(!allocate(size, at, page))
+        break;
+      else
+      {
+        GLbind(*m_tex).Update(page, at.x, at.y, img);
+
+        auto &d = found->second;
+        Val unorm = [](uint v){ return cast<uint16>(glm::round(double(v) / page_size * 65535)); };
+        d.u1 = unorm(at.x);
+        d.v1 = unorm(at.y + img.height);
+        d.u2 = unorm(at.x + img.width);
+        d.v2 = unorm(at.y);
+        d.page = cast<ubyte>(page + 1);
+        m_pages[page].glyphs.emplace_back(font, c);
+        ++loaded;
+      }
+
+      m_pending.pop_front();
+    }
+
+    if(loaded)
+      ++m_epoch;
+
+    StateControl<FboPolicy>::Bind(cast<GLuint>(fbo));
+    GLState::Viewport(cast<uint>(viewport[2]), cast<uint>(viewport[3]), cast<uint>(viewport[0]), cast<uint>(viewport[1]));
+  }
+
+  ++m_frame;
+}
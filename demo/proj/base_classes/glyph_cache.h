@@ -0,0 +1,41 @@
+#pragma once
+#include "gl/texture.h"
+#include <glm/vec2.hpp>
+
+namespace code_policy
+{
+
+struct Font;
+
+struct GlyphCache
+{
+  enum : uint { page_size = 1024, pages = 15, budget = 16, padding = 1 };
+
+  static GlyphCache& Get();
+
+  void Request(Font const*font, uint c);
+  void Touch(uint page) { m_pages[page].used = m_frame; }
+  void Update();
+
+  uint epoch()const { return m_epoch; }
+  GLtex2dArray const* tex()const { return m_tex.get(); }
+
+private:
+  struct Page {
+    bool Allocate(uvec2 size, uvec2 &at);
+    void Clear();
+
+    vector<uvec3> skyline = { uvec3(0, 0, page_size) };
+    vector<pair<Font const*, uint>> glyphs;
+    uint used = 0;
+  };
+
+  bool allocate(uvec2 size, uvec2 &at, uint &page);
+
+  uint m_frame = 1, m_epoch = 0;
+  deque<pair<Font const*, uint>> m_pending;
+  array<Page, pages> m_pages;
+  unique_ptr<GLtex2dArray> m_tex;
+};
+
+}
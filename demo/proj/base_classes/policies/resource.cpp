@@ -1,6 +1,14 @@
 #include "resource.h"
 #include "logging.h"
 #include <fstream>
+#include <sstream>
+#include <cstdio>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace code_policy;
 using namespace std;
@@ -31,7 +39,9 @@ string OnDemandResourcePolicy::LoadText(string const&name)
     file.exceptions(ifstream::failbit | ifstream::badbit);
     try
     {
-      str = string{ istreambuf_iterator<char>(file), istreambuf_iterator<char>() };
+      ostringstream stream;
+      stream<<file.rdbuf();
+      str = stream.str();
       file.close();
     }
     catch(ifstream::failure const&) { CERROR("Error accessing file "<<name); }
@@ -69,9 +79,94 @@ std::vector<char> OnDemandResourcePolicy::Load(string const&name)
   return data;
 }
 
+MappedFile::MappedFile(MappedFile &&r)
+{
+  *this = move(r);
+}
+
+MappedFile& MappedFile::operator=(MappedFile &&r)
+{
+  release();
+  m_data = r.m_data;
+  m_size = r.m_size;
+  m_mapped = r.m_mapped;
+  m_fallback = move(r.m_fallback);
+  r.m_data = nullptr;
+  r.m_size = 0;
+  r.m_mapped = false;
+  return *this;
+}
+
+MappedFile::~MappedFile()
+{
+  release();
+}
+
+void MappedFile::release()
+{
+#ifndef WIN32
+  if(m_mapped)
+    munmap(const_cast<char*>(m_data), m_size);
+#endif
+  m_data = nullptr;
+  m_size = 0;
+  m_mapped = false;
+}
+
+MappedFile OnDemandResourcePolicy::Map(string const&name)
+{
+  MappedFile f;
+#ifndef WIN32
+  Val fd = open(name.c_str(), O_RDONLY);
+  if(fd < 0)
+  {
+    CINFO("No file "<<name);
+    return f;
+  }
+
+  struct stat st;
+  if(!fstat(fd, &st) && st.st_size > 0)
+  {
+    Val size = cast<size_t>(st.st_size);
+    Val data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data != MAP_FAILED)
+    {
+      f.m_data = reinterpret_cast<char const*>(data);
+      f.m_size = size;
+      f.m_mapped = true;
+    }
+    else
+      CINFO("Can't map file "<<name);
+  }
+  close(fd);
+#else
+  f.m_fallback = Load(name);
+  f.m_data = f.m_fallback.data();
+  f.m_size = f.m_fallback.size();
+#endif
+
+  return f;
+}
+
+static bool replaceFile(string const&from, string const&to)
+{
+#ifdef WIN32
+  std::remove(to.c_str());
+#endif
+  if(!std::rename(from.c_str(), to.c_str()))
+    return true;
+
+  CINFO("Can't replace file "<<to);
+  std::remove(from.c_str());
+  return false;
+}
+
+//written next to the target and renamed over it, so whoever still maps the old file keeps reading the old contents;
+//a symlinked target gets replaced by a regular file
 bool OnDemandResourcePolicy::Save(string const&name, vector<char> const&data)
 {
-  ofstream file(name, ofstream::binary | ofstream::out);
+  Val temp = name + ".tmp";
+  ofstream file(temp, ofstream::binary | ofstream::out);
   if(file.is_open())
   {
     file.exceptions(ofstream::failbit | ofstream::badbit);
@@ -79,10 +174,12 @@ bool OnDemandResourcePolicy::Save(string const&name, vector<char> const&data)
     {
       file.write(data.data(), cast<streamsize>(data.size()));
       file.close();
-      return true;
+      return replaceFile(temp, name);
     }
     catch(ofstream::failure const&) { CINFO("Error writing to file "<<name); }
+    file.exceptions(ofstream::goodbit);
     file.close();
+    std::remove(temp.c_str());
   }
   else
     CINFO("Can't create/open file "<<name);
@@ -234,12 +331,24 @@ Archive LZ4CompressionPolicy::Compress(vector<char> const&data)
 
 vector<char> LZ4CompressionPolicy::Extract(Archive const&a)
 {
-  vector<char> buff(a.orig_size);
-  Val written = LZ4_decompress_safe(a.data.data(), buff.data(), a.data.size(), cast<int>(buff.size()));
-  if(written < 0)
+  vector<char> buff;
+  if(!TryExtract(a, buff))
     CERROR("Malformed archive");
 
-  buff.resize(cast<uint>(written));
   return buff;
 }
+
+bool LZ4CompressionPolicy::TryExtract(Archive const&a, vector<char> &out)
+{
+  out.resize(a.orig_size);
+  Val written = LZ4_decompress_safe(a.data.data(), out.data(), cast<int>(a.data.size()), cast<int>(out.size()));
+  if(written < 0)
+  {
+    out.clear();
+    return false;
+  }
+
+  out.resize(cast<uint>(written));
+  return true;
+}
 #endif
@@ -4,11 +4,35 @@
 namespace code_policy
 {
 
+struct MappedFile
+{
+  friend struct OnDemandResourcePolicy;
+
+  MappedFile() = default;
+  MappedFile(MappedFile &&r);
+  MappedFile& operator=(MappedFile &&r);
+  ~MappedFile();
+
+  char const* data()const { return m_data;  }
+  size_t size()const      { return m_size;  }
+  bool empty()const       { return !m_size; }
+
+private:
+  void release();
+
+  char const*m_data = nullptr;
+  size_t m_size = 0;
+  bool m_mapped = false;
+  vector<char> m_fallback;
+};
+
+
 template<class m_policy>
 struct ResourceControl
 {
   static string LoadText(string const&name)                    { return m_policy::LoadText(name);   }
   static vector<char> Load(string const&name)                  { return m_policy::Load(name);       }
+  static MappedFile Map(string const&name)                     { return m_policy::Map(name);        }
   static bool Save(string const&name, vector<char> const&data) { return m_policy::Save(name, data); }
 };
 
@@ -27,6 +51,7 @@ struct CompressionControl
 {
   static Archive Compress(vector<char> const&data) { return m_policy::Compress(data); }
   static vector<char> Extract(Archive const&a)     { return m_policy::Extract(a);     }
+  static bool TryExtract(Archive const&a, vector<char> &out) { return m_policy::TryExtract(a, out); }
 };
 
 
@@ -34,6 +59,7 @@ struct OnDemandResourcePolicy
 {
   static string LoadText(string const&);
   static vector<char> Load(string const&);
+  static MappedFile Map(string const&);
   static bool Save(string const&, vector<char> const&);
 };
 
@@ -58,6 +84,7 @@ struct LZ4CompressionPolicy
 {
   static Archive Compress(vector<char> const&);
   static vector<char> Extract(Archive const&);
+  static bool TryExtract(Archive const&, vector<char>&);
 };
 
 
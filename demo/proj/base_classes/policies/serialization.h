@@ -6,6 +6,8 @@
 #include <cereal/types/vector.hpp>
 #include <cereal/types/array.hpp>
 #include <sstream>
+#include <cstring>
+#include <type_traits>
 
 namespace code_policy
 {
@@ -40,4 +42,83 @@ template<class...P> void deserialize_from_vec(vector<char> const&data, P &&...p)
   }
 }
 
+
+//raw little-endian layout for trivially copyable data, readable in place from a mapped file
+struct FlatOutputArchive
+{
+  template<class...P> void operator()(P const&...p) { (void)std::initializer_list<int>{ (write(p), 0)... }; }
+
+  void append(char const*p, size_t bytes) {
+    align(8);
+    data.insert(data.cend(), p, p + bytes);
+  }
+
+  vector<char> data;
+
+private:
+  void align(size_t a) { data.resize((data.size() + a - 1) / a * a, 0); }
+  template<class T> void write(T const&v) {
+    static_assert(std::is_trivially_copyable<T>::value, "Flat archive stores plain data only");
+    align(alignof(T));
+    data.insert(data.cend(), reinterpret_cast<char const*>(&v), reinterpret_cast<char const*>(&v) + sizeof(T));
+  }
+  template<class T> void write(vector<T> const&v) {
+    static_assert(std::is_trivially_copyable<T>::value, "Flat archive stores plain data only");
+    write(uint64(v.size()));
+    align(8);
+    data.insert(data.cend(), reinterpret_cast<char const*>(v.data()), reinterpret_cast<char const*>(v.data() + v.size()));
+  }
+  void write(string const&v) { write(vector<char>(v.cbegin(), v.cend())); }
+};
+
+struct FlatInputArchive
+{
+  FlatInputArchive(char const*begin, size_t size)
+    : m_begin(begin)
+    , m_at(0)
+    , m_size(size)
+  { }
+
+  template<class...P> void operator()(P &...p) { (void)std::initializer_list<int>{ (read(p), 0)... }; }
+
+  char const* take(size_t bytes) {
+    align(8);
+    return advance(bytes);
+  }
+
+  bool good()const { return m_at <= m_size; }
+
+private:
+  void align(size_t a) { m_at = (m_at + a - 1) / a * a; }
+  char const* advance(size_t bytes) {
+    if(m_at > m_size || bytes > m_size - m_at)
+    {
+      m_at = m_size + 1;
+      return nullptr;
+    }
+    Val r = m_begin + m_at;
+    m_at += bytes;
+    return r;
+  }
+  template<class T> void read(T &v) {
+    align(alignof(T));
+    if(Val p = advance(sizeof(T)))
+      std::memcpy(&v, p, sizeof(T));
+  }
+  template<class T> void read(vector<T> &v) {
+    uint64 n = 0;
+    read(n);
+    if(n > m_size)
+      n = 0, m_at = m_size + 1;
+    Val p = take(size_t(n) * sizeof(T));
+    v.resize(p ? size_t(n) : 0);
+    if(p && n)
+      std::memcpy(v.data(), p, size_t(n) * sizeof(T));
+  }
+  void read(string &v) { vector<char> c; read(c); v.assign(c.cbegin(), c.cend()); }
+
+  char const*m_begin;
+  size_t m_at, m_size;
+};
+
 }
@@ -57,7 +57,7 @@ static Val pack(int w, int h, vector<box> &empty, vector<box> &filled) {
 Val imgAdpt(uImage const&img) { return img;  }
 Val imgAdpt(uImage const*img) { return *img; }
 
-template<class m_key, class T> pair<unordered_map<m_key, Vtex>, map<m_key, T>> code_policy::MakeAtlas(uint max_w, uint max_h, uint channels, map<m_key, T> images)
+template<class m_key, class T> pair<unordered_map<m_key, Vtex>, map<m_key, T>> code_policy::MakeAtlas(uint max_w, uint max_h, uint channels, map<m_key, T> images, uint padding)
 {
   using tile = typename map<m_key, T>::iterator;
   vector<tile> tiles;
@@ -67,7 +67,7 @@ template<class m_key, class T> pair<unordered_map<m_key, Vtex>, map<m_key, T>> c
 
   std::sort(tiles.begin(), tiles.end(), [](Val _l, Val _r){ Val l = imgAdpt(_l->second); Val r = imgAdpt(_r->second); return l.height != r.height ? l.height > r.height : l.width > r.width; });
 
-  Val area = std::accumulate(tiles.cbegin(), tiles.cend(), 0ul, [](uint64 v, Val i){ Val img = imgAdpt(i->second); return v + uint64(img.width) * img.height; });
+  Val area = std::accumulate(tiles.cbegin(), tiles.cend(), 0ul, [padding](uint64 v, Val i){ Val img = imgAdpt(i->second); return v + uint64(img.width + padding) * (img.height + padding); });
   Val width = glm::min(max_w, cast<uint>(glm::pow(2, glm::ceil(glm::log(glm::sqrt(area)) / glm::log(2.)))));
 
   vector<box> empty, filled;
@@ -93,7 +93,7 @@ template<class m_key, class T> pair<unordered_map<m_key, Vtex>, map<m_key, T>> c
         return;
       }
 
-    Val g = pack(cast<int>(img.width), cast<int>(img.height), empty, filled);
+    Val g = pack(cast<int>(img.width + padding), cast<int>(img.height + padding), empty, filled);
     if(g.y2() > cast<int>(max_h) || g.x2() > cast<int>(width))
     {
       leftovers.emplace(move(**i));
@@ -101,14 +101,16 @@ template<class m_key, class T> pair<unordered_map<m_key, Vtex>, map<m_key, T>> c
       return;
     }
 
-    packed.emplace(name, Vtex{ { g.x + 0.5, g.y + 0.5, g.x + g.w - 0.5, g.y + g.h - 0.5 }, nullptr });
+    Val w = cast<int>(img.width)
+        , h = cast<int>(img.height);
+    packed.emplace(name, Vtex{ { g.x + 0.5, g.y + 0.5, g.x + w - 0.5, g.y + h - 0.5 }, nullptr });
 
     atlas.resize(glm::max(cast<size_t>(g.y2()) * width * channels, atlas.size()), 0);
 
     Val data = img.data.cbegin();
     Val c = cast<int>(channels);
-    for(ptrdiff_t j=0; j<g.h; ++j)
-      std::copy(data + j * g.w * c, data + (j+1) * g.w * c, atlas.begin() + ((j + g.y) * width + g.x) * c);
+    for(ptrdiff_t j=0; j<h; ++j)
+      std::copy(data + j * w * c, data + (j+1) * w * c, atlas.begin() + ((j + g.y) * width + g.x) * c);
   }();
 
   Val height = cast<uint>(atlas.size() / (width * channels));
@@ -125,5 +127,5 @@ template<class m_key, class T> pair<unordered_map<m_key, Vtex>, map<m_key, T>> c
 
   return { move(packed), move(leftovers) };
 }
-template pair<unordered_map<uint, Vtex>, map<uint, uImage>> code_policy::MakeAtlas(uint max_w, uint max_h, uint channels, map<uint, uImage> images);
-template pair<unordered_map<string, Vtex>, map<string, uImage>> code_policy::MakeAtlas(uint max_w, uint max_h, uint channels, map<string, uImage> images);
+template pair<unordered_map<uint, Vtex>, map<uint, uImage>> code_policy::MakeAtlas(uint max_w, uint max_h, uint channels, map<uint, uImage> images, uint padding);
+template pair<unordered_map<string, Vtex>, map<string, uImage>> code_policy::MakeAtlas(uint max_w, uint max_h, uint channels, map<string, uImage> images, uint padding);
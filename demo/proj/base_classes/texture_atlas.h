@@ -12,6 +12,6 @@ struct Vtex
 };
 
 
-template<class m_key, class T> pair<unordered_map<m_key, Vtex>, map<m_key, T>> MakeAtlas(uint max_w, uint max_h, uint channels, map<m_key, T> images);
+template<class m_key, class T> pair<unordered_map<m_key, Vtex>, map<m_key, T>> MakeAtlas(uint max_w, uint max_h, uint channels, map<m_key, T> images, uint padding=0);
 
 }
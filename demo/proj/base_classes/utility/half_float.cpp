@@ -0,0 +1,172 @@
+#include "half_float.h"
+#include <glm/gtc/packing.hpp>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HALF_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define HALF_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace code_policy;
+
+static void packScalar(float const*in, uint16 *out, size_t n)
+{
+  for(size_t i=0; i<n; ++i)
+    out[i] = glm::packHalf1x16(in[i]);
+}
+
+
+#if defined(HALF_X86) && defined(__SSE2__)
+static __m128i toHalfSSE2(__m128 f)
+{
+  Val sign_mask = _mm_set1_ps(-0.f);
+  Val f16_max = _mm_set1_epi32((127 + 16) << 23)
+      , nan_bit = _mm_set1_epi32(0x200)
+      , inf = _mm_set1_epi32(0x7c00)
+      , min_normal = _mm_set1_epi32((127 - 14) << 23)
+      , subnorm_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23)
+      , normal_bias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+  Val sign = _mm_and_ps(sign_mask, f);
+  Val abs = _mm_castps_si128(_mm_xor_ps(f, sign));
+  Val is_nan = _mm_castps_si128(_mm_cmpunord_ps(f, f));
+  Val is_regular = _mm_cmpgt_epi32(f16_max, abs);
+  Val special = _mm_or_si128(_mm_and_si128(is_nan, nan_bit), inf);
+  Val is_subnormal = _mm_cmpgt_epi32(min_normal, abs);
+
+  Val subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(abs), _mm_castsi128_ps(subnorm_magic))), subnorm_magic);
+
+  Val odd = _mm_srai_epi32(_mm_slli_epi32(abs, 31 - 13), 31);
+  Val normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(abs, normal_bias), odd), 13);
+
+  Val finite = _mm_or_si128(_mm_and_si128(subnormal, is_subnormal), _mm_andnot_si128(is_subnormal, normal));
+  Val joined = _mm_or_si128(_mm_and_si128(finite, is_regular), _mm_andnot_si128(is_regular, special));
+  Val result = _mm_or_si128(joined, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+
+  return _mm_srai_epi32(_mm_slli_epi32(result, 16), 16);
+}
+
+static void packSSE2(float const*in, uint16 *out, size_t n)
+{
+  size_t i = 0;
+  for(; i+8<=n; i+=8)
+  {
+    Val lo = toHalfSSE2(_mm_loadu_ps(in + i))
+        , hi = toHalfSSE2(_mm_loadu_ps(in + i + 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(lo, hi));
+  }
+
+  packScalar(in + i, out + i, n - i);
+}
+#endif
+
+
+#ifdef HALF_X86
+__attribute__((target("avx,f16c")))
+static void packF16C(float const*in, uint16 *out, size_t n)
+{
+  size_t i = 0;
+  for(; i+8<=n; i+=8)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+
+  if(i == n)
+    return;
+
+  array<float, 8> tail = {{ 0 }};
+  array<uint16, 8> packed;
+  std::copy(in + i, in + n, tail.begin());
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(packed.data()), _mm256_cvtps_ph(_mm256_loadu_ps(tail.data()), _MM_FROUND_TO_NEAREST_INT));
+  std::copy(packed.cbegin(), packed.cbegin() + cast<ptrdiff_t>(n - i), out + i);
+}
+#endif
+
+
+#ifdef HALF_NEON
+static void packNEON(float const*in, uint16 *out, size_t n)
+{
+  size_t i = 0;
+  for(; i+4<=n; i+=4)
+    vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+
+  packScalar(in + i, out + i, n - i);
+}
+#endif
+
+
+using Kernel = pair<HalfKernel, void(*)(float const*, uint16*, size_t)>;
+
+static bool supported(HalfKernel k)
+{
+  switch(k)
+  {
+    case HalfKernel::Scalar: return true;
+#ifdef HALF_X86
+    case HalfKernel::F16C:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+#endif
+#if defined(HALF_X86) && defined(__SSE2__)
+    case HalfKernel::SSE2: return true;
+#endif
+#ifdef HALF_NEON
+    case HalfKernel::NEON: return true;
+#endif
+    default: return false;
+  }
+}
+
+static Kernel makeKernel(HalfKernel k)
+{
+  if(!supported(k))
+    return { HalfKernel::Scalar, packScalar };
+
+  switch(k)
+  {
+#ifdef HALF_X86
+    case HalfKernel::F16C: return { k, packF16C };
+#endif
+#if defined(HALF_X86) && defined(__SSE2__)
+    case HalfKernel::SSE2: return { k, packSSE2 };
+#endif
+#ifdef HALF_NEON
+    case HalfKernel::NEON: return { k, packNEON };
+#endif
+    default: return { HalfKernel::Scalar, packScalar };
+  }
+}
+
+static Kernel selectKernel()
+{
+  for(Val k: { HalfKernel::F16C, HalfKernel::SSE2, HalfKernel::NEON })
+    if(supported(k))
+      return makeKernel(k);
+
+  return makeKernel(HalfKernel::Scalar);
+}
+
+static Kernel& kernel()
+{
+  static auto s_kernel = selectKernel();
+  return s_kernel;
+}
+
+HalfKernel code_policy::ActiveHalfKernel()
+{
+  return kernel().first;
+}
+
+HalfKernel code_policy::ForceHalfKernel(HalfKernel k)
+{
+  Val previous = kernel().first;
+  kernel() = makeKernel(k);
+  return previous;
+}
+
+void code_policy::PackHalf(float const*in, uint16 *out, size_t n)
+{
+  kernel().second(in, out, n);
+}
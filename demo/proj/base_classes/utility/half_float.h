@@ -0,0 +1,13 @@
+#pragma once
+#include "base_classes/policies/logging.h"
+
+namespace code_policy
+{
+
+enum class HalfKernel { Scalar, SSE2, F16C, NEON };
+
+HalfKernel ActiveHalfKernel();
+HalfKernel ForceHalfKernel(HalfKernel k); //for benchmarks; returns the previous kernel, unsupported ones fall back to scalar
+void PackHalf(float const*in, uint16 *out, size_t n);
+
+}
@@ -0,0 +1,305 @@
+#include "msdf.h"
+#include "base_classes/policies/logging.h"
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace code_policy;
+
+namespace
+{
+enum : uint { black = 0, red = 1, green = 2, blue = 4, yellow = red | green, magenta = red | blue, cyan = green | blue, white = 7 };
+enum : uint { curve_steps = 16 };
+
+struct edge
+{
+  vector<vec2> pts;
+  vec2 dir0, dir1;
+  uint color = white;
+};
+
+struct distance
+{
+  bool operator<(distance const&r)const { return std::abs(d) < std::abs(r.d) || (std::abs(d) == std::abs(r.d) && dot < r.dot); }
+
+  float d = 1e30f, dot = 1;
+};
+}
+
+static float cross(vec2 a, vec2 b) { return a.x * b.y - a.y * b.x; }
+
+static vec2 bezier(GlyphShape::Edge const&e, float t)
+{
+  Val s = 1 - t;
+  switch(e.degree)
+  {
+    case 2:  return s * s * e.p[0] + 2 * s * t * e.p[1] + t * t * e.p[2];
+    case 3:  return s * s * s * e.p[0] + 3 * s * s * t * e.p[1] + 3 * s * t * t * e.p[2] + t * t * t * e.p[3];
+    default: return glm::mix(e.p[0], e.p[1], t);
+  }
+}
+
+static edge flatten(GlyphShape::Edge const&e)
+{
+  edge r;
+  Val steps = e.degree > 1 ? uint(curve_steps) : 1u;
+  for(uint i=0; i<=steps; ++i)
+    r.pts.emplace_back(bezier(e, float(i) / float(steps)));
+
+  r.pts.erase(std::unique(r.pts.begin(), r.pts.end()), r.pts.end());
+  if(r.pts.size() > 1)
+  {
+    r.dir0 = glm::normalize(r.pts[1] - r.pts[0]);
+    r.dir1 = glm::normalize(r.pts.back() - r.pts[r.pts.size() - 2]);
+  }
+  return r;
+}
+
+static bool corner(vec2 a, vec2 b)
+{
+  return glm::dot(a, b) <= 0 || std::abs(cross(a, b)) > 0.1411f; //sin(3 rad), same threshold as msdfgen
+}
+
+static void switchColor(uint &color, uint &seed, uint banned=black)
+{
+  Val combined = color & banned;
+  if(combined == red || combined == green || combined == blue)
+  {
+    color = combined ^ white;
+    return;
+  }
+  if(color == black || color == white)
+  {
+    static const uint s_start[3] = { cyan, magenta, yellow };
+    color = s_start[seed % 3];
+    seed /= 3;
+    return;
+  }
+  Val shifted = color << (1 + (seed & 1));
+  color = (shifted | shifted >> 3) & white;
+  seed >>= 1;
+}
+
+static vector<edge> splitInThirds(vector<edge> edges)
+{
+  vector<edge> parts;
+  for(auto &e: edges)
+  {
+    if(e.pts.size() < 4)
+    {
+      Val a = e.pts.front(), b = e.pts.back();
+      e.pts = { a, glm::mix(a, b, 1.f / 3), glm::mix(a, b, 2.f / 3), b };
+    }
+
+    Val n = e.pts.size() - 1;
+    for(size_t i=0; i<3; ++i)
+    {
+      edge p;
+      p.pts.assign(e.pts.cbegin() + cast<ptrdiff_t>(n * i / 3), e.pts.cbegin() + cast<ptrdiff_t>(n * (i + 1) / 3 + 1));
+      p.dir0 = glm::normalize(p.pts[1] - p.pts[0]);
+      p.dir1 = glm::normalize(p.pts.back() - p.pts[p.pts.size() - 2]);
+      parts.emplace_back(move(p));
+    }
+  }
+  return parts;
+}
+
+//msdfgen's simple edge colouring: corners split the contour into runs of alternating two-channel colours
+static void colorContour(vector<edge> &edges, uint &seed)
+{
+  vector<size_t> corners;
+  for(size_t i=0; i<edges.size(); ++i)
+    if(corner(edges[(i + edges.size() - 1) % edges.size()].dir1, edges[i].dir0))
+      corners.emplace_back(i);
+
+  if(corners.empty())
+  {
+    for(auto &e: edges)
+      e.color = white;
+    return;
+  }
+
+  if(corners.size() == 1)
+  {
+    uint colors[3] = { white, white, black };
+    switchColor(colors[0], seed);
+    colors[2] = colors[0];
+    switchColor(colors[2], seed);
+
+    std::rotate(edges.begin(), edges.begin() + cast<ptrdiff_t>(corners[0]), edges.end());
+    if(edges.size() < 3)
+      edges = splitInThirds(move(edges));
+
+    Val m = edges.size();
+    for(size_t i=0; i<m; ++i)
+      edges[i].color = colors[1 + int(3 + 2.875 * double(i) / double(m - 1) - 1.4375 + 0.5) - 3];
+    return;
+  }
+
+  uint color = white;
+  switchColor(color, seed);
+  Val initial = color;
+  size_t spline = 0;
+  for(size_t i=0; i<edges.size(); ++i)
+  {
+    Val index = (corners[0] + i) % edges.size();
+    if(spline + 1 < corners.size() && corners[spline + 1] == index)
+    {
+      ++spline;
+      switchColor(color, seed, spline == corners.size() - 1 ? initial : uint(black));
+    }
+    edges[index].color = color;
+  }
+}
+
+static distance signedDistance(edge const&e, vec2 p, int &side)
+{
+  distance best;
+  Val last = e.pts.size() - 2;
+  for(size_t i=0; i<=last; ++i)
+  {
+    Val a = e.pts[i], b = e.pts[i + 1];
+    Val ab = b - a, aq = p - a;
+    Val t = glm::dot(aq, ab) / glm::dot(ab, ab);
+    Val eq = (t > 0.5f ? b : a) - p;
+    Val end = glm::length(eq);
+
+    distance d;
+    if(t > 0 && t < 1 && std::abs(cross(aq, ab)) / glm::length(ab) < end)
+      d = { cross(aq, ab) / glm::length(ab), 0 };
+    else
+      d = { (cross(aq, ab) >= 0 ? 1.f : -1.f) * end, std::abs(glm::dot(glm::normalize(ab), eq / std::max(end, 1e-12f))) };
+
+    if(d < best)
+    {
+      best = d;
+      side = i == 0 && t < 0 ? -1 : i == last && t > 1 ? 1 : 0;
+    }
+  }
+  return best;
+}
+
+//beyond an edge end, extend the edge along its tangent so corners stay sharp
+static void pseudoDistance(edge const&e, vec2 p, int side, distance &d)
+{
+  Val dir = side < 0 ? e.dir0 : e.dir1;
+  Val q = p - (side < 0 ? e.pts.front() : e.pts.back());
+  Val ts = glm::dot(q, dir);
+  if(side < 0 ? ts < 0 : ts > 0)
+  {
+    Val pseudo = cross(q, dir);
+    if(std::abs(pseudo) <= std::abs(d.d))
+      d = { pseudo, 0 };
+  }
+}
+
+static bool clash(vec3 a, vec3 b, float threshold)
+{
+  Val in = [](vec3 v){ return (v.r > 0.5f) + (v.g > 0.5f) + (v.b > 0.5f); };
+  Val ia = in(a), ib = in(b);
+  if((ia >= 2) != (ib >= 2) ||
+     ia == 0 || ia == 3 ||
+     ib == 0 || ib == 3)
+    return false;
+
+  Val flips = [&](int c){ return (a[c] > 0.5f) != (b[c] > 0.5f) && (a[c] < 0.5f) != (b[c] < 0.5f); };
+  int x, y, z;
+  if(flips(0) && flips(1))      x = 0, y = 1, z = 2;
+  else if(flips(0) && flips(2)) x = 0, y = 2, z = 1;
+  else if(flips(1) && flips(2)) x = 1, y = 2, z = 0;
+  else
+    return false;
+
+  return std::abs(a[x] - b[x]) >= threshold &&
+      std::abs(a[y] - b[y]) >= threshold &&
+      std::abs(a[z] - 0.5f) >= std::abs(b[z] - 0.5f);
+}
+
+static float median(vec3 v) { return std::max(std::min(v.r, v.g), std::min(std::max(v.r, v.g), v.b)); }
+
+uImage code_policy::MakeMsdf(GlyphShape const&shape, uint width, uint height, vec2 scale, vec2 offset, float range)
+{
+  vector<edge> edges;
+  float area = 0;
+  uint seed = 0;
+  for(Val c: shape.contours)
+  {
+    vector<edge> contour;
+    for(Val e: c)
+    {
+      auto f = flatten(e);
+      if(f.pts.size() < 2)
+        continue;
+
+      for(size_t i=1; i<f.pts.size(); ++i)
+        area += cross(f.pts[i - 1], f.pts[i]);
+      contour.emplace_back(move(f));
+    }
+
+    if(contour.empty())
+      continue;
+
+    colorContour(contour, seed);
+    edges.insert(edges.cend(), contour.cbegin(), contour.cend());
+  }
+
+  Val orientation = area > 0 ? -1.f : 1.f;
+  Val px = 1 / std::abs(scale.x);
+  vector<vec3> field(size_t(width) * height, vec3(0));
+
+  for(uint y=0; y<height; ++y)
+    for(uint x=0; x<width; ++x)
+    {
+      Val p = (vec2(x, y) + 0.5f) * scale + offset;
+      distance ch[3];
+      edge const*near[3] = { nullptr, nullptr, nullptr };
+      int side[3] = { 0, 0, 0 };
+
+      for(Val e: edges)
+      {
+        int s = 0;
+        Val d = signedDistance(e, p, s);
+        for(uint c=0; c<3; ++c)
+          if(e.color & (1u << c) && d < ch[c])
+          {
+            ch[c] = d;
+            near[c] = &e;
+            side[c] = s;
+          }
+      }
+
+      auto &v = field[size_t(y) * width + x];
+      for(uint c=0; c<3; ++c)
+      {
+        if(near[c] && side[c])
+          pseudoDistance(*near[c], p, side[c], ch[c]);
+        v[cast<int>(c)] = near[c] ? 0.5f + 0.5f * orientation * ch[c].d * px / range : 0;
+      }
+    }
+
+  Val threshold = 1.001f * 0.5f / range;
+  vector<size_t> clashes;
+  for(uint y=0; y<height; ++y)
+    for(uint x=0; x<width; ++x)
+    {
+      Val at = [&](uint i, uint j){ return field[size_t(j) * width + i]; };
+      Val v = at(x, y);
+      if((x > 0 && clash(v, at(x - 1, y), threshold)) ||
+         (x + 1 < width && clash(v, at(x + 1, y), threshold)) ||
+         (y > 0 && clash(v, at(x, y - 1), threshold)) ||
+         (y + 1 < height && clash(v, at(x, y + 1), threshold)))
+        clashes.emplace_back(size_t(y) * width + x);
+    }
+
+  for(Val i: clashes)
+    field[i] = vec3(median(field[i]));
+
+  uImage img = { width, height, 3, vector<ubyte>(field.size() * 3) };
+  for(size_t i=0; i<field.size(); ++i)
+    for(uint c=0; c<3; ++c)
+      img.data[i * 3 + c] = ubyte(std::round(glm::clamp(field[i][cast<int>(c)], 0.f, 1.f) * 255));
+
+  return img;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "base_classes/policies/utility.h"
+#include <glm/vec2.hpp>
+
+namespace code_policy
+{
+
+struct GlyphShape
+{
+  struct Edge {
+    vec2 p[4];
+    uint degree; //1 line, 2 quadratic, 3 cubic bezier
+  };
+
+  vector<vector<Edge>> contours;
+};
+
+//multi-channel distance field: pixel centre p samples the shape at p * scale + offset,
+//channels store 0.5 + 0.5 * distance / range in pixels, the median of three recovers the outline with sharp corners
+uImage MakeMsdf(GlyphShape const&shape, uint width, uint height, vec2 scale, vec2 offset, float range);
+
+}
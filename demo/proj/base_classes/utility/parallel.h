@@ -0,0 +1,28 @@
+#pragma once
+#include "base_classes/policies/code.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace code_policy
+{
+
+template<class F> void ParallelFor(size_t count, F const&func, uint threads=0)
+{
+  std::atomic<size_t> next(0);
+  const auto work = [&]{
+    for(size_t i=next++; i<count; i=next++)
+      func(i);
+  };
+
+  const size_t n = std::min<size_t>(threads ? threads : std::max(std::thread::hardware_concurrency(), 1u), count);
+  vector<std::thread> pool;
+  for(size_t i=1; i<n; ++i)
+    pool.emplace_back(work);
+
+  work();
+  for(auto &t: pool)
+    t.join();
+}
+
+}
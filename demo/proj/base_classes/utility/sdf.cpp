@@ -1,6 +1,8 @@
 #include "sdf.h"
 #include "base_classes/mesh.h"
 #include "base_classes/gl/texture.h"
+#include "parallel.h"
+#include <cmath>
 
 using namespace code_policy;
 
@@ -56,7 +58,7 @@ d_i = 0.5 + d_i * 0.5;
 glFragColor = vec4(vec3(mix(d_o, d_i, float(d_i > 0.5))), 1.);
 })")
 
-GLtex2d SdfGenerator::generate(GLtex2d tex, uint scale, uint border)const
+GLtex2d SdfGenerator::generate(GLtex2d const&tex, uint scale, uint border)const
 {
   Val width = tex.width()
       , height = tex.height();
@@ -103,3 +105,112 @@ GLtex2d SdfGenerator::generate(GLtex2d tex, uint scale, uint border)const
 
   return surf.TakeTexture();
 }
+
+
+static const float c_far = 1e20f;
+
+static void distanceTransform(float *f, uint n, uint stride, vector<float> &d, vector<uint> &v, vector<float> &z)
+{
+  Val at = [&](uint i)->float& { return f[size_t(i) * stride]; };
+  Val sq = [](uint i){ return float(i) * float(i); };
+
+  uint k = 0;
+  v[0] = 0;
+  z[0] = -c_far;
+  z[1] = c_far;
+  for(uint q=1; q<n; ++q)
+  {
+    Val intersect = [&]{ Val p = v[k]; return ((at(q) + sq(q)) - (at(p) + sq(p))) / (2.f * float(q - p)); };
+    float s = intersect();
+    while(s <= z[k])
+    {
+      --k;
+      s = intersect();
+    }
+
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = c_far;
+  }
+
+  k = 0;
+  for(uint q=0; q<n; ++q)
+  {
+    while(z[k + 1] < float(q))
+      ++k;
+
+    Val p = v[k];
+    d[q] = sq(q > p ? q - p : p - q) + at(p);
+  }
+
+  for(uint q=0; q<n; ++q)
+    at(q) = d[q];
+}
+
+static void distanceTransform(vector<float> &f, uint width, uint height)
+{
+  Val n = std::max(width, height);
+  vector<float> d(n), z(n + 1);
+  vector<uint> v(n);
+
+  for(uint x=0; x<width; ++x)
+    distanceTransform(f.data() + x, height, width, d, v, z);
+  for(uint y=0; y<height; ++y)
+    distanceTransform(f.data() + size_t(y) * width, width, 1, d, v, z);
+}
+
+uImage SdfGenerator::generate(uImage const&img, uint scale, uint border)
+{
+  CASSERT(img.channels == 1, "Sdf source should be single channel");
+  Val width = img.width
+      , height = img.height;
+  Val size = size_t(width) * height;
+
+  vector<float> to_in(size), to_out(size);
+  for(size_t i=0; i<size; ++i)
+  {
+    Val inside = img.data[i] > 127;
+    to_in[i] = inside ? 0 : c_far;
+    to_out[i] = inside ? c_far : 0;
+  }
+
+  distanceTransform(to_in, width, height);
+  distanceTransform(to_out, width, height);
+
+  Val r = float(border);
+  vector<float> field(size);
+  for(size_t i=0; i<size; ++i)
+    field[i] = to_in[i] == 0 ? 0.5f + 0.5f * std::min(std::sqrt(to_out[i]) / r, 1.f)
+                             : 0.5f - 0.5f * std::min(std::sqrt(to_in[i]) / r, 1.f);
+
+  Val w = width / scale
+      , h = height / scale;
+  uImage res = { w, h, 1, vector<ubyte>(size_t(w) * h) };
+  Val texel = [&](int x, int y){
+    return field[size_t(glm::clamp(y, 0, int(height) - 1)) * width + size_t(glm::clamp(x, 0, int(width) - 1))];
+  };
+
+  for(uint y=0; y<h; ++y)
+    for(uint x=0; x<w; ++x)
+    {
+      Val sx = (float(x) + 0.5f) * float(width) / float(w) - 0.5f
+          , sy = (float(y) + 0.5f) * float(height) / float(h) - 0.5f;
+      Val x0 = int(std::floor(sx))
+          , y0 = int(std::floor(sy));
+      Val fx = sx - float(x0)
+          , fy = sy - float(y0);
+      Val v = glm::mix(glm::mix(texel(x0, y0), texel(x0 + 1, y0), fx),
+                       glm::mix(texel(x0, y0 + 1), texel(x0 + 1, y0 + 1), fx), fy);
+      res.data[size_t(y) * w + x] = ubyte(glm::round(glm::clamp(v, 0.f, 1.f) * 255.f));
+    }
+
+  return res;
+}
+
+vector<uImage> SdfGenerator::generate(vector<uImage> const&imgs, uint scale, uint border, uint threads)
+{
+  vector<uImage> res(imgs.size());
+  ParallelFor(imgs.size(), [&](size_t i){ res[i] = generate(imgs[i], scale, border); }, threads);
+  return res;
+}
@@ -7,7 +7,11 @@ namespace code_policy
 
 struct SdfGenerator
 {
-  GLtex2d generate(GLtex2d tex, uint scale, uint border)const;
+  GLtex2d generate(GLtex2d const&tex, uint scale, uint border)const;
+
+  //exact euclidean transform on the cpu, same encoding as the gl passes; no gl context needed
+  static uImage generate(uImage const&img, uint scale, uint border);
+  static vector<uImage> generate(vector<uImage> const&imgs, uint scale, uint border, uint threads=0);
 
 private:
   const GLshader
@@ -0,0 +1,237 @@
+#include "text_buffer.h"
+#include "base_classes/policies/logging.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace code_policy;
+
+static uint64 nextRevision()
+{
+  static uint64 s_revision = 0;
+  return ++s_revision;
+}
+
+static uint nextPriority()
+{
+  static uint s_state = 2463534242u;
+  s_state ^= s_state << 13;
+  s_state ^= s_state >> 17;
+  s_state ^= s_state << 5;
+  return s_state;
+}
+
+TextBuffer::Chunk::Chunk(string8 text)
+{
+  append(text.data(), text.size());
+}
+
+TextBuffer::Chunk::Chunk(shared_ptr<const MappedFile> file, vector<size_t> breaks)
+  : file(move(file))
+  , breaks(move(breaks))
+{ }
+
+void TextBuffer::Chunk::append(char const*text, size_t n)
+{
+  Val base = this->text.size();
+  this->text.append(text, n);
+  for(auto i=text, end=text+n; (i = static_cast<char const*>(std::memchr(i, '\n', cast<size_t>(end - i)))); ++i)
+    breaks.emplace_back(base + cast<size_t>(i - text));
+}
+
+size_t TextBuffer::Chunk::newlines(size_t from, size_t to)const
+{
+  return cast<size_t>(std::lower_bound(breaks.cbegin(), breaks.cend(), to) - std::lower_bound(breaks.cbegin(), breaks.cend(), from));
+}
+
+
+TextBuffer::TextBuffer(string8 text)
+  : m_original(make_shared<const Chunk>(move(text)))
+  , m_add(make_shared<Chunk>(string8{}))
+  , m_revision(nextRevision())
+{
+  if(!m_original->text.empty())
+    m_root = make(piece(0, 0, m_original->text.size()), nextPriority(), nullptr, nullptr);
+}
+
+TextBuffer::TextBuffer(shared_ptr<const MappedFile> file, size_t size, vector<size_t> breaks)
+  : m_original(make_shared<const Chunk>(move(file), move(breaks)))
+  , m_add(make_shared<Chunk>(string8{}))
+  , m_revision(nextRevision())
+{
+  CASSERT(size <= m_original->file->size(), "Text past the end of file");
+  if(size)
+    m_root = make(piece(0, 0, size), nextPriority(), nullptr, nullptr);
+}
+
+size_t TextBuffer::line_start(size_t line)const
+{
+  if(!line)
+    return 0;
+  if(line >= lines())
+    return size();
+
+  size_t base = 0, k = line;
+  for(auto t=m_root.get(); t;)
+  {
+    Val left_bytes = t->l ? t->l->bytes : 0
+        , left_lines = t->l ? t->l->newlines : 0;
+    if(k <= left_lines)
+    {
+      t = t->l.get();
+      continue;
+    }
+
+    k -= left_lines;
+    base += left_bytes;
+    Val p = t->piece;
+    if(k <= p.newlines)
+    {
+      Val b = chunk(p).breaks;
+      Val first = std::lower_bound(b.cbegin(), b.cend(), p.start);
+      return base + *(first + cast<ptrdiff_t>(k - 1)) - p.start + 1;
+    }
+
+    k -= p.newlines;
+    base += p.size;
+    t = t->r.get();
+  }
+
+  return size();
+}
+
+size_t TextBuffer::line_of(size_t offset)const
+{
+  size_t lines = 0;
+  for(auto t=m_root.get(); t;)
+  {
+    Val left_bytes = t->l ? t->l->bytes : 0;
+    if(offset < left_bytes)
+    {
+      t = t->l.get();
+      continue;
+    }
+
+    offset -= left_bytes;
+    lines += t->l ? t->l->newlines : 0;
+    Val p = t->piece;
+    if(offset < p.size)
+      return lines + chunk(p).newlines(p.start, p.start + offset);
+
+    offset -= p.size;
+    lines += p.newlines;
+    t = t->r.get();
+  }
+
+  return lines;
+}
+
+string8 TextBuffer::substr(size_t at, size_t n)const
+{
+  const size_t to = std::min(size(), at + n);
+  string8 s;
+  if(at >= to)
+    return s;
+
+  s.reserve(to - at);
+  visit(m_root, 0, at, to, [&](char const*data, size_t n){ s.append(data, n); });
+  return s;
+}
+
+string8 TextBuffer::str()const
+{
+  return substr(0, size());
+}
+
+void TextBuffer::Insert(size_t at, char const*text, size_t n)
+{
+  CASSERT(at <= size(), "Insert past the end of text");
+  if(!n)
+    return;
+
+  Val start = m_add->text.size();
+  m_add->append(text, n);
+  auto s = split(m_root, at);
+  m_root = merge(merge(s.first, make(piece(1, start, n), nextPriority(), nullptr, nullptr)), s.second);
+  m_revision = nextRevision();
+}
+
+void TextBuffer::Erase(size_t at, size_t n)
+{
+  CASSERT(at + n <= size(), "Erase past the end of text");
+  if(!n)
+    return;
+
+  auto l = split(m_root, at);
+  Val r = split(l.second, n);
+  m_root = merge(l.first, r.second);
+  m_revision = nextRevision();
+}
+
+TextBuffer::Piece TextBuffer::piece(uint c, size_t start, size_t size)const
+{
+  Piece p = { c, start, size, 0 };
+  p.newlines = chunk(p).newlines(start, start + size);
+  return p;
+}
+
+TextBuffer::Ptr TextBuffer::make(Piece const&p, uint priority, Ptr l, Ptr r)
+{
+  Val bytes = p.size + (l ? l->bytes : 0) + (r ? r->bytes : 0)
+      , newlines = p.newlines + (l ? l->newlines : 0) + (r ? r->newlines : 0);
+  return make_shared<const Node>(Node{ p, priority, move(l), move(r), bytes, newlines });
+}
+
+pair<TextBuffer::Ptr, TextBuffer::Ptr> TextBuffer::split(Ptr const&t, size_t at)const
+{
+  if(!t)
+    return {};
+
+  Val left_bytes = t->l ? t->l->bytes : 0;
+  Val p = t->piece;
+  if(at <= left_bytes)
+  {
+    auto s = split(t->l, at);
+    return { s.first, make(p, t->priority, s.second, t->r) };
+  }
+
+  if(at >= left_bytes + p.size)
+  {
+    auto s = split(t->r, at - left_bytes - p.size);
+    return { make(p, t->priority, t->l, s.first), s.second };
+  }
+
+  Val k = at - left_bytes;
+  return { make(piece(p.chunk, p.start, k), t->priority, t->l, nullptr),
+           make(piece(p.chunk, p.start + k, p.size - k), t->priority, nullptr, t->r) };
+}
+
+TextBuffer::Ptr TextBuffer::merge(Ptr const&l, Ptr const&r)
+{
+  if(!l || !r)
+    return l ? l : r;
+
+  if(l->priority > r->priority)
+    return make(l->piece, l->priority, l->l, merge(l->r, r));
+
+  return make(r->piece, r->priority, merge(l, r->l), r->r);
+}
+
+template<class F> void TextBuffer::visit(Ptr const&t, size_t base, size_t from, size_t to, F const&f)const
+{
+  if(!t ||
+     base >= to ||
+     base + t->bytes <= from)
+    return;
+
+  Val left_bytes = t->l ? t->l->bytes : 0;
+  visit(t->l, base, from, to, f);
+
+  Val p = t->piece;
+  Val b = base + left_bytes;
+  const size_t s = std::max(b, from)
+             , e = std::min(b + p.size, to);
+  if(s < e)
+    f(chunk(p).data() + p.start + (s - b), e - s);
+
+  visit(t->r, b + p.size, from, to, f);
+}
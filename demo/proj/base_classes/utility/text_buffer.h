@@ -0,0 +1,66 @@
+#pragma once
+#include "base_classes/policies/resource.h"
+
+namespace code_policy
+{
+
+//piece table over an immutable original and an append-only add buffer, pieces live in a persistent treap
+//so edits are O(log n) and copies share structure. line starts are resolved through per-buffer newline indices
+struct TextBuffer
+{
+  TextBuffer(string8 text={});
+  TextBuffer(shared_ptr<const MappedFile> file, size_t size, vector<size_t> breaks);
+
+  bool empty()const   { return !m_root;                                 }
+  size_t size()const  { return m_root ? m_root->bytes : 0;             }
+  size_t lines()const { return (m_root ? m_root->newlines : 0) + 1;    }
+  uint64 revision()const { return m_revision; }
+
+  size_t line_start(size_t line)const;
+  size_t line_of(size_t offset)const;
+  string8 substr(size_t at, size_t n)const;
+  string8 str()const;
+
+  void Insert(size_t at, char const*text, size_t n);
+  void Insert(size_t at, string8 const&text) { Insert(at, text.data(), text.size()); }
+  void Erase(size_t at, size_t n);
+
+private:
+  struct Chunk {
+    Chunk(string8 text);
+    Chunk(shared_ptr<const MappedFile> file, vector<size_t> breaks);
+    char const* data()const { return file ? file->data() : text.data(); }
+    void append(char const*text, size_t n);
+    size_t newlines(size_t from, size_t to)const;
+
+    string8 text;
+    shared_ptr<const MappedFile> file;
+    vector<size_t> breaks;
+  };
+
+  struct Piece { uint chunk; size_t start, size, newlines; };
+
+  struct Node;
+  using Ptr = shared_ptr<const Node>;
+  struct Node {
+    Piece piece;
+    uint priority;
+    Ptr l, r;
+    size_t bytes, newlines;
+  };
+
+  Piece piece(uint chunk, size_t start, size_t size)const;
+  Chunk const& chunk(Piece const&p)const { return p.chunk ? *m_add : *m_original; }
+
+  static Ptr make(Piece const&p, uint priority, Ptr l, Ptr r);
+  pair<Ptr, Ptr> split(Ptr const&t, size_t at)const;
+  static Ptr merge(Ptr const&l, Ptr const&r);
+  template<class F> void visit(Ptr const&t, size_t base, size_t from, size_t to, F const&f)const;
+
+  shared_ptr<const Chunk> m_original;
+  shared_ptr<Chunk> m_add;
+  Ptr m_root;
+  uint64 m_revision;
+};
+
+}
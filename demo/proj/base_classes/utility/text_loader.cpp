@@ -0,0 +1,103 @@
+#include "text_loader.h"
+#include "parallel.h"
+#include "base_classes/policies/logging.h"
+#include <utfcpp/utf8.h>
+#include <cstring>
+
+using namespace code_policy;
+
+static size_t codepointStart(char const*data, size_t size, size_t at)
+{
+  for(uint i=0; i<3 && at<size && (data[at] & 0xc0) == 0x80; ++i)
+    ++at;
+  return at;
+}
+
+static void newlines(char const*data, size_t from, size_t to, vector<size_t> &breaks)
+{
+  if(from == to)
+    return;
+
+  for(auto i=data+from, end=data+to; (i = static_cast<char const*>(std::memchr(i, '\n', cast<size_t>(end - i)))); ++i)
+    breaks.emplace_back(cast<size_t>(i - data));
+}
+
+
+TextLoader::TextLoader(string const&name)
+  : m_file(make_shared<const MappedFile>(Resource::Map(name)))
+  , m_indexed(0)
+  , m_done(false)
+  , m_valid(false)
+  , m_cancel(false)
+{
+  Val data = m_file->data();
+  Val size = m_file->size();
+
+  vector<size_t> breaks;
+  newlines(data, 0, std::min(size, size_t(preview_size)), breaks);
+  size_t end = size;
+  if(size > preview_size)
+  {
+    end = breaks.empty() ? codepointStart(data, size, preview_size) : breaks.back();
+    if(!breaks.empty())
+      breaks.pop_back();
+  }
+
+  if(utf8::is_valid(data, data + end))
+    m_preview = TextBuffer(m_file, end, move(breaks));
+
+  m_worker = std::thread([this]{ index(); });
+}
+
+TextLoader::~TextLoader()
+{
+  m_cancel = true;
+  m_worker.join();
+}
+
+float TextLoader::progress()const
+{
+  return m_file->empty() ? 1.f : float(double(m_indexed) / double(m_file->size()));
+}
+
+TextBuffer TextLoader::result()
+{
+  CASSERT(done(), "Text isn't indexed yet");
+  if(!m_valid)
+    return {};
+
+  return TextBuffer(m_file, m_file->size(), move(m_breaks));
+}
+
+void TextLoader::index()
+{
+  Val data = m_file->data();
+  Val size = m_file->size();
+  Val slices = (size + slice_size - 1) / slice_size;
+
+  vector<vector<size_t>> breaks(slices);
+  std::atomic<bool> valid(true);
+  ParallelFor(slices, [&](size_t i){
+    if(m_cancel || !valid)
+      return;
+
+    Val from = codepointStart(data, size, i * slice_size)
+        , to = codepointStart(data, size, std::min(size, (i + 1) * slice_size));
+    if(!utf8::is_valid(data + from, data + to))
+      valid = false;
+
+    newlines(data, from, to, breaks[i]);
+    m_indexed += to - from;
+  });
+
+  size_t total = 0;
+  for(Val i: breaks)
+    total += i.size();
+
+  m_breaks.reserve(total);
+  for(Val i: breaks)
+    m_breaks.insert(m_breaks.cend(), i.cbegin(), i.cend());
+
+  m_valid = valid && !m_cancel;
+  m_done = true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "text_buffer.h"
+#include <atomic>
+#include <thread>
+
+namespace code_policy
+{
+
+//maps a file and returns a buffer over its first screen at once, while the newline index and utf8 validation
+//of the whole file are built on a worker thread. result() is available once done(), it keeps reading from the mapping,
+//which stays intact since Resource::Save replaces files instead of writing into them
+struct TextLoader
+{
+  TextLoader(string const&name);
+  ~TextLoader();
+
+  TextBuffer const& preview()const { return m_preview; }
+  float progress()const;
+  bool done()const  { return m_done;  }
+  bool valid()const { return m_valid; }
+  TextBuffer result();
+
+private:
+  enum : size_t { preview_size = 256 << 10, slice_size = 16 << 20 };
+
+  void index();
+
+  shared_ptr<const MappedFile> m_file;
+  TextBuffer m_preview;
+  vector<size_t> m_breaks;
+  std::atomic<size_t> m_indexed;
+  std::atomic<bool> m_done, m_valid, m_cancel;
+  std::thread m_worker;
+};
+
+}
@@ -4,7 +4,7 @@
 
 using namespace GUI;
 
-void Button::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, string8 const&text)
+void Button::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, Interned const&text)
 {
   Val text_padding = 1.f / 10;
 
@@ -17,20 +17,26 @@ void Button::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, string8 const
     m_size = size;
 
     Val padding = size * text_padding;
-    Val text_size = Text::GetSizeFor(text, t.font, size.y).first + padding;
+    Val text_size = Text::GetSizeFor(text.str(), t.font, size.y).first + padding;
     Val scale_coeff = size / text_size;
     Val scale = glm::min(scale_coeff.x, scale_coeff.y);
     m_scale = size.y * scale;
     m_offset = vec2(size - (text_size - padding) * scale) / 2.f;
   }
 
-  Val delta = (1. / (t.easing * glm::abs(m_easing - 2.f)));
-  m_easing += hovered ? delta : -delta;
-  m_easing = glm::clamp(m_easing, 0.f, 1.f);
-
-  Val color = glm::mix(t.foreground, t.foreground_focus, m_easing);
+  Val now = r.time();
+  Val color = pressed ? t.highlight : hovered ? t.foreground_focus : t.foreground;
+  if(m_tween.color_to != color)
+  {
+    m_tween.color_from = m_tween.start > 0 ? m_tween.color(now) : color;
+    m_tween.color_to = color;
+    m_tween.colored = true;
+    m_tween.start = now;
+    m_tween.duration = pressed ? 0 : t.easing / 1000.f;
+  }
 
-  r.Draw<Rect>(pos, size, pressed ? t.highlight : color);
+  r.Draw<Rect>(pos, size, vec4(vec3(color), glm::min(m_tween.color_from.a, m_tween.color_to.a)));
+  r.Animate(m_tween);
   r.Logic([this](Val e){
     if(e.type() != Event::Type::MouseButton)
       return false;
@@ -42,5 +48,5 @@ void Button::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, string8 const
   hovered = r.hovered();
   pressed &= hovered;
 
-  r.Draw<Text>(pos + m_offset, text, t.font, m_scale, pressed ? t.text_highlight : hovered ? t.text_focus : t.text);
+  r.Draw<Text>(pos + m_offset, m_text, t.font, m_scale, pressed ? t.text_highlight : hovered ? t.text_focus : t.text);
 }
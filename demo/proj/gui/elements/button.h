@@ -1,5 +1,5 @@
 #pragma once
-#include "base_classes/policies/code.h"
+#include "../objects.h"
 #include <glm/vec2.hpp>
 
 namespace GUI
@@ -7,13 +7,14 @@ namespace GUI
 
 struct Button
 {
-  void Draw(struct Renderer &r, struct Theme const&t, vec2 pos, vec2 size, string8 const&text);
+  void Draw(struct Renderer &r, struct Theme const&t, vec2 pos, vec2 size, Interned const&text);
 
   bool pressed = false, hovered = false;
 private:
-  float m_scale, m_easing = 0.;
+  float m_scale;
+  Tween m_tween;
   vec2 m_offset, m_size;
-  string8 m_text;
+  Interned m_text;
 };
 
 }
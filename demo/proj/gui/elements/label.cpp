@@ -4,20 +4,20 @@
 
 using namespace GUI;
 
-void Label::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, string8 text)
+void Label::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, Interned const&text)
 {
   Val text_padding = 1.f / 10;
 
   r.Clip(pos, size);
 
-  if(m_old_text != text ||
+  if(m_text != text ||
      !Window::Get().equalPos(m_size, size))
   {
-    m_old_text = text;
+    m_text = text;
     m_size = size;
 
     Val padding = size * text_padding;
-    Val text_size = vec2(Text::GetSizeFor(text, t.font, size.y).first.x, size.y) + padding;
+    Val text_size = vec2(Text::GetSizeFor(text.str(), t.font, size.y).first.x, size.y) + padding;
     Val scale_coeff = size / text_size;
     Val scale = glm::min(scale_coeff.x, scale_coeff.y);
     m_scale = size.y * scale;
@@ -28,5 +28,22 @@ void Label::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, string8 text)
 
   pos += m_offset;
 
-  r.Draw<Text>(pos, move(text), t.font, m_scale, t.text);
+  r.Draw<Text>(pos, m_text, t.font, m_scale, t.text);
+}
+
+void Label::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, string8 text, float scale)
+{
+  r.Clip(pos, size);
+
+  m_layout.Layout(t.font, scale, size.x);
+  m_layout.Update(text);
+
+  Val visible = glm::min(m_layout.lines(), cast<uint>(size.y / scale) + 1);
+  m_layout.Wrap(0, visible);
+  m_layout.Wrap();
+
+  r.Draw<Rect>(pos, size, t.foreground);
+
+  for(uint i=0; i<visible; ++i)
+    r.Draw<Text>(pos + vec2(0, size.y - scale * (i + 1)), m_layout.interned(i), t.font, scale, t.text);
 }
@@ -1,5 +1,5 @@
 #pragma once
-#include "base_classes/policies/code.h"
+#include "../paragraphs.h"
 #include <glm/vec2.hpp>
 
 namespace GUI
@@ -7,12 +7,14 @@ namespace GUI
 
 struct Label
 {
-  void Draw(struct Renderer &r, struct Theme const&t, vec2 pos, vec2 size, string8 text);
+  void Draw(struct Renderer &r, struct Theme const&t, vec2 pos, vec2 size, Interned const&text);
+  void Draw(struct Renderer &r, struct Theme const&t, vec2 pos, vec2 size, string8 text, float scale); //multi-line, wrapped to size.x
 
 private:
   float m_scale;
   vec2 m_offset, m_size;
-  string8 m_old_text;
+  Interned m_text;
+  Paragraphs m_layout;
 };
 
 }
@@ -15,8 +15,8 @@ void Layout::Draw(Renderer &r, Theme const&t, function<void(vec2 const&, vec2 co
 
   r.Clip(pos - vec2(0, corner_padding), size + vec2(corner_padding));
 
-  r.Draw<Rect>(pos, size, t.background);
-  r.Draw<Rect>(pos + vec2(0, size.y - top_padding), vec2(size.x, top_padding), t.highlight);
+  r.Draw<Frame>(pos, size, uint(Frame::Raised), t.background);
+  r.Draw<Frame>(pos + vec2(0, size.y - top_padding), vec2(size.x, top_padding), uint(Frame::Bordered), t.highlight);
   r.Logic([this, &r](Val e){
     switch(e.type())
     {
@@ -6,6 +6,20 @@
 
 using namespace GUI;
 
+Advances const& LineEdit::advances(Font const*font)
+{
+  if(!m_advances.built() ||
+     m_advances_revision != m_revision ||
+     m_advances_font != font)
+  {
+    m_advances_revision = m_revision;
+    m_advances_font = font;
+    m_advances = Advances(text, font);
+  }
+
+  return m_advances;
+}
+
 void LineEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size)
 {
   Val text_padding = 1.f / 10
@@ -18,6 +32,7 @@ void LineEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size)
   {
     m_old_text = text;
     m_size = size;
+    ++m_revision;
 
     Val padding = size * text_padding;
     Val text_size = vec2(Text::GetSizeFor(text, t.font, size.y).first.x, size.y) + padding;
@@ -35,11 +50,11 @@ void LineEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size)
 
     Val calc_cursor = [&](Val click){
       Val p = click - pos;
-      return cast<int>(Text::GetSizeFor(text, t.font, m_scale, glm::max(p.x, 0.f)).second);
+      return cast<int>(advances(t.font).fit(glm::max(p.x, 0.f), m_scale));
     };
 
     Val set_cursor = [&](Val c){
-      return cast<int>(Text::GetSizeFor(text, t.font, m_scale, -1, glm::max(c, 0)).second);
+      return cast<int>(glm::min(cast<uint>(glm::max(c, 0)), advances(t.font).glyphs()));
     };
 
     Val find_text_iter = [&](Val c){
@@ -97,6 +112,7 @@ void LineEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size)
             const auto begin = adv;
             utf8::unchecked::next(adv);
             text.erase(begin, adv);
+            ++m_revision;
             return true;
           }
 
@@ -109,6 +125,7 @@ void LineEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size)
             const auto end = adv;
             utf8::unchecked::previous(adv);
             text.erase(adv, end);
+            ++m_revision;
             m_cursor = set_cursor(m_cursor - 1);
             return true;
           }
@@ -122,6 +139,7 @@ void LineEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size)
           return true;
 
         utf8::unchecked::append(e.unichar(), std::inserter(text, find_text_iter(m_cursor)));
+        ++m_revision;
         m_cursor = set_cursor(m_cursor + 1);
         return true;
       }
@@ -132,7 +150,7 @@ void LineEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size)
 
   if(m_focused)
   {
-    Val w_cursor = Text::GetSizeFor(text, t.font, m_scale, -1, m_cursor).first.x;
+    Val w_cursor = advances(t.font).width(cast<uint>(glm::max(m_cursor, 0)), m_scale);
     r.Draw<Rect>(pos + vec2(w_cursor, 0), vec2(cursor_padding, m_scale), t.highlight);
   }
 
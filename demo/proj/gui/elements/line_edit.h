@@ -1,5 +1,5 @@
 #pragma once
-#include "base_classes/policies/code.h"
+#include "../objects.h"
 #include <glm/vec2.hpp>
 
 namespace GUI
@@ -11,11 +11,17 @@ struct LineEdit
 
   string8 text;
 private:
+  Advances const& advances(Font const*font);
+
   bool m_hovered = false, m_focused = false;
   float m_scale;
   int m_cursor;
   vec2 m_offset, m_size;
   string8 m_old_text;
+  //advances are keyed on a revision bumped on every edit and on the font, so lookups never compare the text
+  uint m_revision = 0, m_advances_revision = 0;
+  Font const*m_advances_font = nullptr;
+  Advances m_advances;
 };
 
 }
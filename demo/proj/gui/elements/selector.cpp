@@ -11,9 +11,16 @@ void Selector::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, vector<stri
   hovered = r.hovered({ pos, pos + total_size });
   active &= hovered;
 
+  //text and choices are plain strings owned by the caller, they are interned here once per change
+  Val intern = [](Interned &i, String s){
+    if(i.str() != s)
+      i = Interned(s);
+    return i;
+  };
+
   if(!active)
   {
-    m_button.Draw(r, t, pos, size, text);
+    m_button.Draw(r, t, pos, size, intern(m_caption, text));
     if(!m_button.pressed)
       return;
 
@@ -24,9 +31,10 @@ void Selector::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, vector<stri
   else
   {
     m_choices.resize(choices.size());
+    m_choice_captions.resize(choices.size());
     for(uint i=0; i<m_choices.size(); ++i)
     {
-      m_choices[i].Draw(r, t, pos + size * vec2(0, 1 + i), size, choices[i]);
+      m_choices[i].Draw(r, t, pos + size * vec2(0, 1 + i), size, intern(m_choice_captions[i], choices[i]));
       if(m_choices[i].pressed)
       {
         text = choices[i];
@@ -16,6 +16,8 @@ private:
   Button m_button;
   LineEdit m_line_edit;
   vector<Button> m_choices;
+  Interned m_caption;
+  vector<Interned> m_choice_captions;
 };
 
 }
@@ -0,0 +1,69 @@
+#include "stats_overlay.h"
+#include "../resource_control.h"
+#include <numeric>
+#include <sstream>
+
+using namespace GUI;
+
+void StatsOverlay::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size)
+{
+  Val text_h = 0.2f
+      , bar_gap = 0.1f;
+  Val time_colors = array<vec4, 5>{ to_rgba(0x4E79A7FF), to_rgba(0xF28E2BFF), to_rgba(0x59A14FFF), to_rgba(0xE15759FF), to_rgba(0xEDC948FF) };
+  Val cache_colors = array<vec4, 2>{ to_rgba(0xB07AA1FF), to_rgba(0xFF9DA7FF) };
+
+  m_history.emplace_back(r.stats());
+  while(m_history.size() > glm::max(frames, 1u))
+    m_history.pop_front();
+
+  r.Clip(pos, size);
+  r.Draw<Rect>(pos, size, t.background);
+
+  Val graph_h = size.y * (1 - text_h) / 2
+      , column_w = size.x / glm::max(frames, 1u);
+  Val times = [](Val s){ return array<double, 5>{ s.time_compare, s.time_batching, s.time_mesh, s.time_upload, s.time_gpu }; };
+  Val max_time = std::accumulate(m_history.cbegin(), m_history.cend(), 1e-6, [&](double v, Val s){
+    Val f = times(s);
+    return glm::max(v, glm::max(f[0] + f[1] + f[2] + f[3], f[4]));
+  });
+
+  for(uint i=0; i<m_history.size(); ++i)
+  {
+    Val s = m_history[i];
+    Val x = pos.x + column_w * (frames - m_history.size() + i)
+        , w = column_w * (1 - bar_gap);
+
+    Val f = times(s);
+    float y = pos.y + graph_h;
+    for(uint j=0; j<4; ++j)
+    {
+      Val h = float(f[j] / max_time) * graph_h;
+      if(h > 0)
+        r.Draw<Rect>(vec2(x, y), vec2(w, h), time_colors[j]);
+      y += h;
+    }
+    if(f[4] > 0)
+      r.Draw<Rect>(vec2(x, pos.y + graph_h + float(f[4] / max_time) * graph_h), vec2(w, graph_h / 50), time_colors[4]);
+
+    Val objects = float(glm::max(s.objects, 1u))
+        , changed = float(s.changed + s.mismatched) / objects
+        , invalidated = float(s.objects - glm::min(s.first_invalid, s.objects)) / objects;
+    r.Draw<Rect>(vec2(x, pos.y), vec2(w / 2, invalidated * graph_h), cache_colors[0]);
+    r.Draw<Rect>(vec2(x + w / 2, pos.y), vec2(w / 2, changed * graph_h), cache_colors[1]);
+  }
+
+  Val last = m_history.back();
+  Val summary = [&]{
+    Val us = [](double t){ return std::to_string(cast<uint>(t * 1e6)); };
+    std::stringstream ss;
+    ss<<"obj "<<last.objects<<" =/"<<last.unchanged<<" ~/"<<last.changed<<" !/"<<last.mismatched
+      <<" inv@"<<last.first_invalid<<" b "<<last.batches<<" dc "<<last.draw_calls<<" sw "<<last.shader_switches
+      <<" vtx "<<last.vertices_regenerated<<" up "<<(last.bytes_idx + last.bytes_xyzw + last.bytes_rgba + last.bytes_uv + last.bytes_slot + last.bytes_colors + last.bytes_tweens) / 1024<<"k"
+      <<" us "<<us(last.time_compare)<<"/"<<us(last.time_batching)<<"/"<<us(last.time_mesh)<<"/"<<us(last.time_upload)<<" gpu "<<us(last.time_gpu);
+    return ss.str();
+  }();
+
+  Val text_size = Text::GetSizeFor(summary, t.font, size.y * text_h).first;
+  Val scale = size.y * text_h * glm::min(1.f, size.x / glm::max(text_size.x, 1e-6f));
+  r.Draw<Text>(pos + vec2(0, graph_h * 2), summary, t.font, scale, t.text);
+}
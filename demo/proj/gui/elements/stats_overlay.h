@@ -0,0 +1,17 @@
+#pragma once
+#include "base_classes/policies/code.h"
+#include "../renderer.h"
+
+namespace GUI
+{
+
+struct StatsOverlay
+{
+  void Draw(struct Renderer &r, struct Theme const&t, vec2 pos, vec2 size);
+
+  uint frames = 120;
+private:
+  deque<Renderer::Stats> m_history;
+};
+
+}
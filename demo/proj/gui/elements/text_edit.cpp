@@ -3,36 +3,9 @@
 #include "base_classes/policies/window.h"
 #include <utfcpp/utf8.h>
 #include <GLFW/glfw3.h>
-#include <sstream>
 
 using namespace GUI;
 
-static void parse_text(vector<string8> &lines, set<int> &wraps, string8 const&text, Font const*font, float scale, float max_w)
-{
-  wraps.clear();
-  lines.clear();
-  std::stringstream ss(text);
-  string8 line;
-  while(std::getline(ss, line, '\n'))
-  {
-    if(line.empty())
-      lines.emplace_back("");
-    else
-      while(!line.empty())
-      {
-        Val last_fit = glm::max(1u, Text::GetSizeFor(line, font, scale, max_w).second);
-        auto start = line.cbegin();
-        utf8::unchecked::advance(start, last_fit);
-        lines.emplace_back(line.cbegin(), start);
-        line.erase(line.cbegin(), start);
-        if(!line.empty())
-          wraps.emplace(cast<int>(lines.size()) - 1);
-      }
-  }
-  lines.emplace_back("");
-}
-
-
 void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale, bool readonly)
 {
   Val scroll_padding = 0.02
@@ -40,70 +13,84 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
 
   r.Clip(pos, size);
 
-  Val numbers_bar_w = glm::min(double(size.x), t.font->charData('0').adv * (m_scale / (t.font->topline() - t.font->bottomline())) * (glm::floor(std::log10(glm::max(cast<uint>(m_lines.size() - m_wraps.size()), 1u))) + 2));
+  Val numbers_bar_w = glm::min(double(size.x), t.font->charData('0').adv * (m_scale / (t.font->topline() - t.font->bottomline())) * (glm::floor(std::log10(glm::max(m_layout.paragraphs(), 1u))) + 2));
 
   pos += vec2(numbers_bar_w, 0);
   size = glm::max(vec2(0), size - vec2(scroll_padding + numbers_bar_w, 0));
 
-  Val update_text = [this, &t]{
-    m_old_text = text;
-    parse_text(m_lines, m_wraps, text, t.font, m_scale, m_size.x);
+  m_scale = scale;
+  m_size = size;
+  m_layout.Layout(t.font, m_scale, m_size.x);
+  m_layout.Update(text);
+
+  //lines on screen straight from the scroll position, so a frame only touches what is visible
+  Val visible_lines = [this]{
+    Val bottom = (1. - m_scrollbar.bar) * m_layout.lines();
+    Val first = cast<uint>(glm::max(0., glm::floor(bottom - m_size.y / m_scale)))
+        , end = cast<uint>(glm::clamp(glm::ceil(bottom), 0., double(m_layout.lines())));
+    return uvec2(first, glm::max(first, end));
   };
 
-  Val window = Window::Get();
-  if(m_old_text != text ||
-     !window.equalPos(m_scale, scale) ||
-     !window.equalPos(m_size, size))
-  {
-    m_scale = scale;
-    m_size = size;
-    update_text();
-  }
+  Val wrap_range = visible_lines();
+  m_layout.Wrap(wrap_range.x, wrap_range.y - wrap_range.x);
+  m_layout.Wrap();
 
-  Val max_line = [this]{ return glm::max(cast<int>(m_lines.size()) - 1, 0); };
-  Val line = [this, max_line](Val at){ return m_lines.empty() ? string8{} : m_lines[cast<uint>(glm::clamp(at, 0, max_line()))]; };
+  Val max_line = [this]{ return glm::max(cast<int>(m_layout.lines()) - 1, 0); };
+  Val line = [this, max_line](Val at){ return m_layout.text(cast<uint>(glm::clamp(at, 0, max_line()))); };
+  Val advances = [this, max_line](Val at) -> Advances const& { return m_layout.advances(cast<uint>(glm::clamp(at, 0, max_line()))); };
 
-  Val whole_text_size = m_scale * m_lines.size()
+  Val whole_text_size = m_scale * m_layout.lines()
       , visible_part = m_size.y / whole_text_size;
 
   if(m_old_cursor != cursor)
   {
     m_old_cursor = cursor;
     cursor = glm::max(cursor, ivec2(0));
-    Val screen_y = (float(m_lines.size()) - (cursor.y + 1)) / m_lines.size();
-    m_scrollbar.bar = glm::clamp(m_scrollbar.bar, screen_y - visible_part + 1.f / m_lines.size(), screen_y);
+    Val lines = float(m_layout.lines());
+    Val screen_y = (lines - (cursor.y + 1)) / lines;
+    m_scrollbar.bar = glm::clamp(m_scrollbar.bar, screen_y - visible_part + 1.f / lines, screen_y);
   }
   selection = glm::max(selection, ivec2(0));
   m_scrollbar.bar = glm::clamp(m_scrollbar.bar, 0.f, 1.f - visible_part);
 
   r.Draw<Rect>(pos - vec2(numbers_bar_w, 0), size + vec2(scroll_padding + numbers_bar_w, 0), t.background);
-  r.Logic([this, update_text, pos, &t, &r, max_line, line, whole_text_size, readonly](Val e){
+  r.Logic([this, pos, &t, &r, max_line, line, advances, whole_text_size, readonly](Val e){
 
     Val length = [](Val s){ return cast<int>(utf8::unchecked::distance(s.cbegin(), s.cend())); };
 
     Val calc_cursor = [&](Val click){
       Val p = click - pos + vec2(0, m_scrollbar.bar * whole_text_size);
-      Val line_idx = cast<int>(m_lines.size()) - 1 - cast<int>(p.y / m_scale)
-          , count = cast<int>(Text::GetSizeFor(line(line_idx), t.font, m_scale, glm::max(p.x, 0.f)).second);
+      Val line_idx = cast<int>(m_layout.lines()) - 1 - cast<int>(p.y / m_scale)
+          , count = cast<int>(advances(line_idx).fit(glm::max(p.x, 0.f), m_scale));
       return ivec2(count, line_idx);
     };
 
     Val set_cursor = [&](Val c){
       Val h = glm::clamp(c.y, 0, max_line())
-          , count = cast<int>(Text::GetSizeFor(line(c.y), t.font, m_scale, -1, glm::max(c.x, 0)).second);
+          , count = cast<int>(glm::min(cast<uint>(glm::max(c.x, 0)), advances(c.y).glyphs()));
       return ivec2(c.x == cursor.x ? cursor.x : count, h);
     };
 
-    Val find_text_iter = [&](Val c){
-      auto adv = text.begin();
-      Val h = glm::min(c.y, max_line());
-      for(int i=0; i<h; ++i)
-      {
-        adv += cast<int64>(line(i).size());
-        adv += (*adv == '\n' ? 1 : 0);
-      }
-      utf8::unchecked::advance(adv, glm::min(c.x, length(line(c.y))));
-      return adv;
+    Val find_offset = [&](Val c){
+      Val h = glm::clamp(c.y, 0, max_line());
+      Val l = line(h);
+      auto adv = l.cbegin();
+      utf8::unchecked::advance(adv, glm::min(c.x, length(l)));
+      return glm::min(m_layout.span(cast<uint>(h)).first + cast<size_t>(adv - l.cbegin()), text.size());
+    };
+
+    Val insert = [&](size_t at, String str){
+      m_layout.Update(text);
+      m_history.record(text, at, {}, str, cursor);
+      text.Insert(at, str);
+      m_layout.Edit(text, at, 0, str.size());
+    };
+
+    Val erase = [&](size_t from, size_t to){
+      m_layout.Update(text);
+      m_history.record(text, from, text.substr(from, to - from), {}, cursor);
+      text.Erase(from, to - from);
+      m_layout.Edit(text, from, to - from, 0);
     };
 
     Val selection_begin = [&]{
@@ -120,7 +107,7 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
       if(selection == cursor)
         return false;
 
-      text.erase(find_text_iter(selection_begin()), find_text_iter(selection_end()));
+      erase(find_offset(selection_begin()), find_offset(selection_end()));
       return true;
     };
 
@@ -243,7 +230,7 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
             erase_selected();
             selection = cursor = set_cursor(selection_begin());
 
-            text.insert(find_text_iter(selection_begin()), str.cbegin(), str.cend());
+            insert(find_offset(selection_begin()), str);
 
             m_history.increment(text, cursor);
             return true;
@@ -255,7 +242,8 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
                selection == cursor)
               return true;
 
-            Window::Get().setClipboard({ find_text_iter(selection_begin()), find_text_iter(selection_end()) });
+            Val b = find_offset(selection_begin());
+            Window::Get().setClipboard(text.substr(b, find_offset(selection_end()) - b));
             return true;
           }
 
@@ -266,7 +254,8 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
                selection == cursor)
               return true;
 
-            Window::Get().setClipboard({ find_text_iter(selection_begin()), find_text_iter(selection_end()) });
+            Val b = find_offset(selection_begin());
+            Window::Get().setClipboard(text.substr(b, find_offset(selection_end()) - b));
 
             erase_selected();
             selection = cursor = set_cursor(selection_begin());
@@ -281,10 +270,11 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
                !ctrl_held)
               return true;
 
+            m_layout.Update(text);
             if(shift_held)
-              m_history.repeat_increment(text, cursor);
+              m_history.repeat_increment(text, m_layout, cursor);
             else
-              m_history.restore(text, cursor);
+              m_history.restore(text, m_layout, cursor);
 
             cursor = selection = cursor;
             return true;
@@ -296,9 +286,9 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
               return true;
 
             Val c = selection_begin();
-            Val after_wrap = c.x == 0 && m_wraps.cend() != m_wraps.find(c.y - 1);
+            Val after_wrap = c.x == 0 && c.y > 0 && m_layout.wrapped(cast<uint>(c.y - 1));
             erase_selected();
-            text.insert(find_text_iter(c), '\n');
+            insert(find_offset(c), "\n");
 
             cursor = selection = set_cursor(after_wrap ? c : ivec2(0, c.y + 1));
 
@@ -312,20 +302,21 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
               return true;
 
             Val c = selection_begin();
-            auto adv = find_text_iter(c);
+            Val at = find_offset(c);
 
             if(erase_selected())
               cursor = selection = set_cursor(c);
             else
             {
-              if(adv == text.cend())
+              if(at == text.size())
                 return true;
 
               Val w = glm::min(c.x, length(line(c.y)));
 
-              const auto begin = adv;
+              Val next = text.substr(at, 4);
+              auto adv = next.cbegin();
               utf8::unchecked::next(adv);
-              text.erase(begin, adv);
+              erase(at, at + cast<size_t>(adv - next.cbegin()));
               cursor = selection = set_cursor(ivec2(w, c.y));
             }
 
@@ -339,18 +330,20 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
               return true;
 
             Val c = selection_begin();
-            auto adv = find_text_iter(c);
+            Val at = find_offset(c);
 
             if(erase_selected())
               cursor = selection = set_cursor(c);
             else
             {
-              if(adv == text.cbegin())
+              if(!at)
                 return true;
 
-              const auto end = adv;
+              Val from = at - glm::min(at, size_t(4));
+              Val prev = text.substr(from, at - from);
+              auto adv = prev.cend();
               Val erased_char = utf8::unchecked::previous(adv);
-              text.erase(adv, end);
+              erase(from + cast<size_t>(adv - prev.cbegin()), at);
 
               Val up_line_idx = glm::max(0, c.y - 1);
               Val up_line_w = length(line(up_line_idx));
@@ -374,11 +367,11 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
 
         Val c = selection_begin();
         erase_selected();
-        utf8::unchecked::append(e.unichar(), std::inserter(text, find_text_iter(c)));
-
-        update_text();
+        string8 str;
+        utf8::unchecked::append(e.unichar(), std::back_inserter(str));
+        insert(find_offset(c), str);
 
-        Val wrap = m_wraps.cend() == m_wraps.find(c.y);
+        Val wrap = !m_layout.wrapped(cast<uint>(c.y));
         cursor = selection = set_cursor(wrap ? c + ivec2(1, 0) : ivec2(1, c.y + 1));
 
         m_history.increment(text, cursor);
@@ -392,25 +385,28 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
   Val line_pos = [&](Val n){ return (1. - m_scrollbar.bar) * whole_text_size - scale * (n + 1); };
   Val visible =  [&](Val p){ return (p.y < pos.y + size.y) && (p.y + scale > pos.y); };
 
-  for(Val i: m_wraps)
+  Val range = visible_lines();
+
+  for(uint i=range.x; i<range.y; ++i)
   {
     Val p = pos + vec2(size.x - cursor_padding, line_pos(i)) - vec2(cursor_padding);
-    if(visible(p))
+    if(m_layout.wrapped(i) &&
+       visible(p))
       r.Draw<Rect>(p, vec2(cursor_padding), t.highlight);
   }
 
   if(cursor != selection)
   {
     Val seq = cursor.y != selection.y ? cursor.y > selection.y : cursor.x > selection.x;
-    Val w_selection = Text::GetSizeFor(line(selection.y), t.font, m_scale, -1, selection.x).first.x
-        , w_cursor = Text::GetSizeFor(line(cursor.y), t.font, m_scale, -1, cursor.x).first.x;
+    Val w_selection = advances(selection.y).width(cast<uint>(selection.x), m_scale)
+        , w_cursor = advances(cursor.y).width(cast<uint>(cursor.x), m_scale);
     Val w_begin = seq ? w_selection : w_cursor;
     Val w_end =   seq ? w_cursor : w_selection;
 
     Val begin = glm::min(cursor.y, selection.y)
         , end = glm::max(cursor.y, selection.y);
 
-    for(int i=begin; i<=end; ++i)
+    for(int i=glm::max(begin, cast<int>(range.x)); i<=glm::min(end, cast<int>(range.y) - 1); ++i)
     {
       Val w = i != begin ? 0 : w_begin;
       Val p = pos + vec2(w, line_pos(i));
@@ -421,7 +417,7 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
   else
     if(m_focused)
     {
-      Val w_cursor = Text::GetSizeFor(line(cursor.y), t.font, m_scale, -1, cursor.x).first.x;
+      Val w_cursor = advances(cursor.y).width(cast<uint>(cursor.x), m_scale);
 
       Val p = pos + vec2(w_cursor, line_pos(cursor.y));
       if(visible(p))
@@ -435,64 +431,167 @@ void TextEdit::Draw(Renderer &r, Theme const&t, vec2 pos, vec2 size, float scale
 
   r.Draw<Rect>(pos - vec2(numbers_bar_w, 0), vec2(numbers_bar_w, size.y), t.foreground);
 
-  for(size_t i=0, j=1; i<m_lines.size(); ++i)
+  if(range.y > range.x)
   {
-    Val p = pos - vec2(numbers_bar_w, 0) + vec2(0, line_pos(i));
-    if(m_wraps.cend() == m_wraps.find(i))
+    Val first = m_layout.paragraph(range.x)
+        , last = m_layout.paragraph(range.y - 1);
+    if(first < m_numbers_first ||
+       last >= m_numbers_first + m_numbers.size())
     {
-      if(visible(p))
-        r.Draw<Text>(p, std::to_string(j), t.font, scale, t.highlight);
-      ++j;
+      vector<Interned> numbers;
+      for(uint n=first; n<=last; ++n)
+        numbers.emplace_back(std::to_string(n + 1));
+      m_numbers = move(numbers);
+      m_numbers_first = first;
     }
   }
 
-  for(size_t i=0; i<m_lines.size(); ++i)
+  for(uint i=range.x; i<range.y; ++i)
+  {
+    Val p = pos - vec2(numbers_bar_w, 0) + vec2(0, line_pos(i));
+    if(!m_layout.wrapped(i) &&
+       visible(p))
+      r.Draw<Text>(p, m_numbers[m_layout.paragraph(i) - m_numbers_first], t.font, scale, t.highlight);
+  }
+
+  for(uint i=range.x; i<range.y; ++i)
   {
     Val p = pos + vec2(0, line_pos(i));
     if(visible(p))
-      r.Draw<Text>(p, m_lines[i], t.font, scale, t.text);
+      r.Draw<Text>(p, m_layout.interned(i), t.font, scale, t.text);
   }
 }
 
 
-void TextEdit::History::restore(string8 &text, ivec2 &cursor)
+void TextEdit::History::record(TextBuffer const&text, size_t at, string8 erased, string8 inserted, ivec2 const&cursor)
 {
-  if(m_history.empty())
-    return;
+  if(!m_recording)
+  {
+    if(text.revision() != m_revision)
+      clear(text);
 
-  if(m_at)
-    --m_at;
+    m_open = { {}, cursor, cursor };
+    m_recording = true;
+  }
 
-  Val h = m_history[m_at];
-  text = h.first;
-  cursor = h.second;
+  m_open.ops.push_back({ at, move(erased), move(inserted) });
 }
 
-void TextEdit::History::repeat_increment(string8 &text, ivec2 &cursor)
+void TextEdit::History::increment(TextBuffer const&text, ivec2 const&cursor)
 {
-  if(m_at + 1 >= m_history.size())
+  if(!m_recording)
+    return;
+
+  m_recording = false;
+  m_open.after = cursor;
+  m_revision = text.revision();
+
+  for(; m_steps.size() > m_at; m_steps.pop_back())
+    m_bytes -= m_steps.back().bytes();
+
+  if(coalesce())
     return;
 
+  m_bytes += m_open.bytes();
+  m_steps.emplace_back(move(m_open));
   ++m_at;
-  Val h = m_history[m_at];
-  text = h.first;
-  cursor = h.second;
+
+  for(; m_bytes > budget && m_steps.size() > 1; --m_at)
+  {
+    m_bytes -= m_steps.front().bytes();
+    m_steps.pop_front();
+  }
 }
 
-void TextEdit::History::increment(string8 const&text, ivec2 const&cursor)
+void TextEdit::History::restore(TextBuffer &text, Paragraphs &layout, ivec2 &cursor)
 {
-  if(m_history.empty())
-    m_history.emplace_back(text, cursor);
+  if(text.revision() != m_revision)
+    clear(text);
 
-  if(m_history.back().first == text)
+  if(!m_at)
     return;
 
-  m_history.resize(m_at + 1);
+  Val step = m_steps[--m_at];
+  for(auto i=step.ops.crbegin(); i!=step.ops.crend(); ++i)
+  {
+    text.Erase(i->at, i->inserted.size());
+    layout.Edit(text, i->at, i->inserted.size(), 0);
+    text.Insert(i->at, i->erased);
+    layout.Edit(text, i->at, 0, i->erased.size());
+  }
+
+  cursor = step.before;
+  m_revision = text.revision();
+}
+
+void TextEdit::History::repeat_increment(TextBuffer &text, Paragraphs &layout, ivec2 &cursor)
+{
+  if(text.revision() != m_revision)
+    clear(text);
+
+  if(m_at >= m_steps.size())
+    return;
+
+  Val step = m_steps[m_at++];
+  for(Val i: step.ops)
+  {
+    text.Erase(i.at, i.erased.size());
+    layout.Edit(text, i.at, i.erased.size(), 0);
+    text.Insert(i.at, i.inserted);
+    layout.Edit(text, i.at, 0, i.inserted.size());
+  }
+
+  cursor = step.after;
+  m_revision = text.revision();
+}
+
+void TextEdit::History::clear(TextBuffer const&text)
+{
+  m_steps.clear();
+  m_recording = false;
+  m_at = m_bytes = 0;
+  m_revision = text.revision();
+}
 
-  if(m_history.size() >= 500)
-    m_history.pop_front();
+size_t TextEdit::History::Step::bytes()const
+{
+  size_t b = sizeof(Step);
+  for(Val i: ops)
+    b += sizeof(Op) + i.erased.size() + i.inserted.size();
+  return b;
+}
 
-  m_at = m_history.size();
+//typing run until a word starts after whitespace, backspace and delete runs until a line break
+bool TextEdit::History::coalesce()
+{
+  if(!m_at ||
+     m_open.ops.size() != 1 ||
+     m_steps.back().ops.size() != 1)
+    return false;
+
+  auto &prev = m_steps.back();
+  auto &p = prev.ops.front();
+  Val o = m_open.ops.front();
+  Val single = [](String s){ return !s.empty() && s.size() <= 4 && s != "\n"; };
+  Val space = [](char c){ return c == ' ' || c == '\t'; };
+
+  if(o.erased.empty() && p.erased.empty() && !p.inserted.empty() &&
+     single(o.inserted) && o.at == p.at + p.inserted.size() &&
+     !(space(p.inserted.back()) && !space(o.inserted.front())))
+    p.inserted += o.inserted;
+  else if(o.inserted.empty() && p.inserted.empty() &&
+          single(o.erased) && o.at + o.erased.size() == p.at)
+  {
+    p.erased = o.erased + p.erased;
+    p.at = o.at;
+  }
+  else if(o.inserted.empty() && p.inserted.empty() &&
+          single(o.erased) && o.at == p.at)
+    p.erased += o.erased;
+  else
+    return false;
 
-  m_history.emplace_back(text, cursor);
+  m_bytes += o.erased.size() + o.inserted.size();
+  prev.after = m_open.after;
+  return true;
 }
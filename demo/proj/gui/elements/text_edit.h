@@ -1,5 +1,6 @@
 #pragma once
 #include "slider.h"
+#include "../paragraphs.h"
 
 namespace GUI
 {
@@ -10,29 +11,48 @@ struct TextEdit
 
   void write_history() {
     cursor = selection = ivec2(-1);
-    m_history.increment(text, cursor);
+    m_history.clear(text);
   }
 
-  string8 text;
+  TextBuffer text;
   ivec2 cursor, selection;
 private:
+  //log of insert/erase spans grouped into user steps; typing and single-char deletes coalesce into one step,
+  //oldest steps are dropped once the log outgrows its byte budget
   struct History {
-    void restore(string8 &text, ivec2 &cursor);
-    void repeat_increment(string8 &text, ivec2 &cursor);
-    void increment(string8 const&text, ivec2 const&cursor);
+    void record(TextBuffer const&text, size_t at, string8 erased, string8 inserted, ivec2 const&cursor);
+    void increment(TextBuffer const&text, ivec2 const&cursor);
+    void restore(TextBuffer &text, Paragraphs &layout, ivec2 &cursor);
+    void repeat_increment(TextBuffer &text, Paragraphs &layout, ivec2 &cursor);
+    void clear(TextBuffer const&text);
 
   private:
-    uint m_at = 0;
-    deque<pair<string8, ivec2>> m_history;
+    enum : size_t { budget = 64 << 20 };
+
+    struct Op { size_t at; string8 erased, inserted; };
+    struct Step {
+      size_t bytes()const;
+
+      vector<Op> ops;
+      ivec2 before, after;
+    };
+
+    bool coalesce();
+
+    deque<Step> m_steps;
+    Step m_open;
+    bool m_recording = false;
+    size_t m_at = 0, m_bytes = 0;
+    uint64 m_revision = 0;
   };
 
   bool m_hovered = false, m_pressed = false, m_focused = false;
   float m_scale = 0;
   ivec2 m_old_cursor;
   vec2 m_size;
-  string8 m_old_text;
-  set<int> m_wraps;
-  vector<string8> m_lines;
+  Paragraphs m_layout;
+  vector<Interned> m_numbers; //labels for the visible paragraphs, starting at m_numbers_first
+  uint m_numbers_first = 0;
   History m_history;
   VerticalSlider m_scrollbar;
 };
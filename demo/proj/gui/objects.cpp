@@ -1,40 +1,88 @@
 #include "objects.h"
 #include "base_classes/font.h"
+#include "base_classes/glyph_cache.h"
 #include "base_classes/texture_atlas.h"
 #include "base_classes/policies/window.h"
 #include "base_classes/gl/shader.h"
+#include "base_classes/utility/half_float.h"
+#include "plot.h"
 #include <glm/gtc/epsilon.hpp>
 #include <glm/gtc/packing.hpp>
 #include <utfcpp/utf8.h>
+#include <list>
+#include <algorithm>
 
 using namespace GUI;
 using glm::packHalf1x16;
 
-SHADER(gui__pos_col_vs,
-R"(#version 330 core
-layout(location = 0)in vec3 Position;
-layout(location = 1)in vec4 Color;
-out vec4 glColor;
+static const char c_clip_glsl[] =
+R"(layout(std140) uniform Clips { vec4 clips[1024]; };
 
-void main()
+void clip(vec2 p, uint idx)
 {
-gl_Position = vec4(Position, 1.);
-glColor = Color;
-})")
+vec4 c = clips[idx & 1023u];
+gl_ClipDistance[0] = p.x - c.x;
+gl_ClipDistance[1] = c.z - p.x;
+gl_ClipDistance[2] = p.y - c.y;
+gl_ClipDistance[3] = c.w - p.y;
+})";
+
+static const char c_color_glsl[] =
+R"(layout(std140) uniform FrameConstants { vec4 frame; };
+uniform samplerBuffer colors;
+
+int slotIndex(uint slot)
+{
+return int(slot) + int(frame.y);
+}
+
+vec4 color(vec4 c, uint slot, uint meta)
+{
+return (meta & 32768u) != 0u ? texelFetch(colors, slotIndex(slot)) : c;
+})";
+
+static const char c_tween_glsl[] =
+R"(uniform samplerBuffer tweens;
+
+float ease(float t, float curve)
+{
+t = clamp(t, 0., 1.);
+if(curve < .5) return t;
+if(curve < 1.5) return t * t;
+if(curve < 2.5) return t * (2. - t);
+return t * t * (3. - 2. * t);
+}
+
+vec4 tween(inout vec2 p, vec4 c, uint slot, uint meta)
+{
+if((meta & 16384u) == 0u)
+return c;
+
+int i = slotIndex(slot) * 5;
+vec4 offset = texelFetch(tweens, i + 2)
+, scale = texelFetch(tweens, i + 3)
+, timing = texelFetch(tweens, i + 4);
+float t = ease((frame.x - timing.x) / max(timing.y, 1e-6), timing.z);
+p = (p - scale.zw) * mix(scale.x, scale.y, t) + scale.zw + mix(offset.xy, offset.zw, t);
+return timing.w > .5 ? mix(texelFetch(tweens, i), texelFetch(tweens, i + 1), t) : c;
+})";
 
 SHADER(gui__pos_col_tex_z_vs,
 R"(#version 330 core
-layout(location = 0)in vec4 Position;
+layout(location = 0)in vec3 Position;
 layout(location = 1)in vec4 Color;
 layout(location = 2)in vec2 TexCoord;
+layout(location = 3)in uint Meta;
+layout(location = 4)in uint Slot;
 out vec4 glColor;
-out vec3 glTexCoord;
-
+out vec3 glTexCoord;)", c_clip_glsl, c_color_glsl, c_tween_glsl, R"(
 void main()
 {
-gl_Position = vec4(Position.xyz, 1.);
-glColor = Color;
-glTexCoord = vec3(TexCoord, Position.a);
+vec2 p = Position.xy;
+glColor = tween(p, color(Color, Slot, Meta), Slot, Meta);
+gl_Position = vec4(p, Position.z, 1.);
+clip(p, Meta >> 4);
+glTexCoord = vec3(TexCoord, float(Meta & 15u));
 })")
 
 SHADER(gui__pos_col_tex_vs,
@@ -42,14 +90,71 @@ R"(#version 330 core
 layout(location = 0)in vec3 Position;
 layout(location = 1)in vec4 Color;
 layout(location = 2)in vec2 TexCoord;
+layout(location = 3)in uint Meta;
+layout(location = 4)in uint Slot;
 out vec4 glColor;
 out vec2 glTexCoord;
-
+flat out uint glPage;)", c_clip_glsl, c_color_glsl, c_tween_glsl, R"(
 void main()
 {
-gl_Position = vec4(Position, 1.);
-glColor = Color;
+vec2 p = Position.xy;
+glColor = tween(p, color(Color, Slot, Meta), Slot, Meta);
+gl_Position = vec4(p, Position.z, 1.);
+clip(p, Meta >> 4);
 glTexCoord = TexCoord;
+glPage = Meta & 15u;
+})")
+
+SHADER(gui__plot_vs,
+R"(#version 330 core
+uniform samplerBuffer samples;
+uniform int offsets[32];
+uniform int levels, count, columns, first;
+uniform vec4 rect;
+uniform vec4 view;
+uniform int clip_idx;
+uniform float pixel, level;
+uniform vec4 color;
+out vec4 glColor;)", c_clip_glsl, R"(
+
+float at(int i)
+{
+return texelFetch(samples, clamp(i, 0, count - 1)).x;
+}
+
+void main()
+{
+int c = gl_VertexID / 2;
+float spc = view.y / float(columns);
+float a = view.x + float(c) * spc;
+vec2 mm;
+
+if(spc < 1.)
+{
+float t = a + spc * 0.5;
+int i = first + int(floor(t));
+mm = vec2(mix(at(i), at(i + 1), fract(t)));
+}
+else
+{
+int i0 = clamp(first + int(floor(a)), 0, count - 1);
+int i1 = clamp(first + int(ceil(a + spc)) + 1, i0 + 1, count);
+int l = clamp(int(log2(spc)), 0, levels - 1);
+int j1 = ((i1 - 1) >> l) + 1;
+mm = vec2(1e30, -1e30);
+for(int j=i0>>l; j<j1; ++j)
+{
+vec2 s = texelFetch(samples, offsets[l] + j).xy;
+mm = vec2(min(mm.x, s.x), max(mm.y, s.y));
+}
+}
+
+float v = gl_VertexID % 2 == 0 ? mm.x : mm.y;
+float y = rect.y + (v - view.z) / (view.w - view.z) * rect.w + (gl_VertexID % 2 == 0 ? -pixel : pixel);
+float x = rect.x + (float(c) + 0.5) / float(columns) * rect.z;
+gl_Position = vec4(x, y, level, 1.);
+clip(gl_Position.xy, uint(clip_idx));
+glColor = color;
 })")
 
 SHADER(gui__col_ps,
@@ -79,25 +184,56 @@ R"(#version 330 core
 in vec4 glColor;
 in vec3 glTexCoord;
 layout(location = 0)out vec4 glFragColor;
-uniform sampler2D theme;
+uniform vec4 styles[16];
 
 void main()
 {
-float d = length(glTexCoord.xy);
-vec4 c = texture(theme, vec2(d, glTexCoord.z));
-glFragColor = glColor * c;
+int s = int(glTexCoord.z + 0.5);
+if(s == 0)
+{
+glFragColor = glColor;
+return;
+}
+
+vec4 st = styles[s];
+vec2 half_quad = 1. / abs(vec2(dFdx(glTexCoord.x), dFdy(glTexCoord.y)));
+vec2 p = glTexCoord.xy * half_quad;
+vec2 b = half_quad - st.z;
+float r = min(st.x, min(b.x, b.y));
+vec2 q = abs(p) - b + r;
+float d = length(max(q, 0.)) + min(max(q.x, q.y), 0.) - r;
+
+float fill = clamp(0.5 - d, 0., 1.) * glColor.a;
+float border = clamp(d + st.y + 0.5, 0., 1.);
+float shadow = st.z > 0. ? 0.5 * glColor.a * (1. - smoothstep(0., st.z, d)) : 0.;
+float a = fill + shadow * (1. - fill);
+
+vec3 c = mix(glColor.rgb, glColor.rgb * st.w, border);
+glFragColor = vec4(c * fill / max(a, 1e-4), a);
 })")
 
 SHADER(gui_sdf_ps,
 R"(#version 330 core
 in vec4 glColor;
 in vec2 glTexCoord;
+flat in uint glPage;
 layout(location = 0)out vec4 glFragColor;
 uniform sampler2D src;
+uniform sampler2DArray pages;
+uniform bool msdf;
+
+float sdf(vec2 uv)
+{
+if(glPage != 0u)
+  return texture(pages, vec3(uv, float(glPage - 1u))).r;
+
+vec3 c = texture(src, uv).rgb;
+return msdf ? max(min(c.r, c.g), min(max(c.r, c.g), c.b)) : c.r;
+}
 
 void main()
 {
-ivec2 sz = textureSize(src, 0);
+ivec2 sz = glPage == 0u ? textureSize(src, 0) : textureSize(pages, 0).xy;
 
 float dx = dFdx( glTexCoord.x ) * sz.x;
 float dy = dFdy( glTexCoord.y ) * sz.y;
@@ -106,11 +242,11 @@ float toPixels = 8 * inversesqrt( dx * dx + dy * dy );
 
 vec2 step = vec2(dFdx(glTexCoord.x) * 0.5, 0.);
 
-float pix_l = texture(src, glTexCoord.xy - step).r - 0.5;
-float pix_r = texture(src, glTexCoord.xy + step).r - 0.5;
-float pix_n = texture(src, glTexCoord.xy + step * 2.).r - 0.5;
+float pix_l = sdf(glTexCoord.xy - step) - 0.5;
+float pix_r = sdf(glTexCoord.xy + step) - 0.5;
+float pix_n = sdf(glTexCoord.xy + step * 2.) - 0.5;
 
-float pix = clamp((texture(src, glTexCoord.xy).r - 0.5) * 8 * toPixels + 0.5 , 0., 1.);
+float pix = clamp((sdf(glTexCoord.xy) - 0.5) * 8 * toPixels + 0.5 , 0., 1.);
 
 pix_l = clamp(pix_l * toPixels + 1, 0., 1.);
 pix_r = clamp(pix_r * toPixels + 1, 0., 1.);
@@ -154,63 +290,116 @@ vector<GLushort> Obj::genIdx(uint start, uint size)const
 
   return v;
 }
-/*
-vector<GLushort> 9Sprite::genIdx(uint start, uint size)const
-{
-  vector<GLushort> v;
-  v.reserve((size * 8) / 27);
 
-  for(uint i=start; i<start+size; i+=16)
-  {
-    Val s = [i](uint j){ return GLushort(i + j); };
-    v.insert(v.cend(), { s(0), s(1), s(4), s(4), s(1), s(5),  s(5), s(1), s(2), s(2), s(5), s(6),  s(6), s(2), s(3), s(3), s(6), s(7),  s(7), s(6), s(11), s(11), s(6), s(10),  s(10), s(6), s(5), s(5), s(10), s(9),  s(9), s(5), s(4), s(4), s(9), s(8),  s(8), s(9), s(12), s(12), s(9), s(13),  s(13), s(9), s(10), s(10), s(13), s(14),  s(14), s(10), s(11), s(11), s(14), s(15) });
-  }
-
-  return v;
-}*/
-
-
-void Obj::Draw(GLbindingVao const&b, GLushort num, GLushort offset)const
+void Sprite::Draw(GLbindingVao const&b, GLushort num, GLushort offset)const
 {
-  static const GLshader s_s = { "gui__pos_col_vs", "gui__col_ps" };
+  static const GLshader s_s = []{ GLshader s = { "gui__pos_col_tex_vs", "gui__col_tex_ps" }; auto b = GLbind(s); b.Uniforms("src", 0, "colors", ColorTable::unit, "tweens", TweenTable::unit); b.UniformBlock("Clips", ClipTable::binding); b.UniformBlock("FrameConstants", TweenTable::binding); return s; }();
   GLbind(s_s);
+  GLbind(*m_tex->tex, 0);
   b.DrawOffset(num, offset);
 }
 
-void Sprite::Draw(GLbindingVao const&b, GLushort num, GLushort offset)const
+static void drawFrames(GLbindingVao const&b, GLushort num, GLushort offset)
 {
-  static const GLshader s_s = []{ GLshader s = { "gui__pos_col_tex_vs", "gui__col_tex_ps" }; GLbind(s).Uniform("src", 0); return s; }();
-  GLbind(s_s);
-  GLbind(*m_tex->tex, 0);
+  static const GLshader s_s = []{ GLshader s = { "gui__pos_col_tex_z_vs", "gui__frame_ps" }; auto b = GLbind(s); b.Uniforms("colors", ColorTable::unit, "tweens", TweenTable::unit); b.UniformBlock("Clips", ClipTable::binding); b.UniformBlock("FrameConstants", TweenTable::binding); return s; }();
+  GLbind(s_s).Uniform("styles", Frame::styles());
   b.DrawOffset(num, offset);
 }
 
-/*void 9Sprite::Draw(GLbindingVao const&b, GLushort num, GLushort offset)const
+void Rect::Draw(GLbindingVao const&b, GLushort num, GLushort offset)const
 {
-  static const GLshader s_s = { "gui__pos_col_tex_z_vs", "gui__frame_ps" };
-  static const GLtex theme = []{ GLtex t = GLtex::FromResource(ResourceLoader::Load(themes_file.c_str()), 4); GLbind(t).Parameters(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); return t; }();
-  GLbind(s_s);
-  GLbind(theme, 0);
-  b.DrawOffset(num, offset);
-}*/
+  drawFrames(b, num, offset);
+}
+
+void Frame::Draw(GLbindingVao const&b, GLushort num, GLushort offset)const
+{
+  drawFrames(b, num, offset);
+}
+
+void Plot::Draw(GLbindingVao const&, GLushort, GLushort)const
+{
+  static const GLshader s_s = []{ GLshader s = { "gui__plot_vs", "gui__col_ps" }; auto b = GLbind(s); b.Uniform("samples", 0); b.UniformBlock("Clips", ClipTable::binding); return s; }();
+  static const GLvao s_vao;
+
+  Val d = *m_data;
+  Val v = d.view;
+  if(d.size() < 2 ||
+     v.count <= 0 ||
+     v.max <= v.min)
+    return;
+
+  Val window = Window::Get();
+  Val aspect = window.aspect();
+  Val columns = glm::max(1.f, glm::round(m_size.x * aspect.x * window.size().x / 2));
+  Val spc = v.count / cast<double>(columns);
+
+  //only columns that have samples are drawn, the clip rect is applied per vertex through Clips
+  Val with_data = vec2(cast<float>(glm::floor(-v.first / spc) - 1), cast<float>(glm::ceil((cast<double>(d.size()) - v.first) / spc) + 1))
+      , range = glm::clamp(with_data, vec2(0), vec2(columns));
+  if(range.y <= range.x)
+    return;
+
+  Val tex = d.Upload();
+  auto s = GLbind(s_s);
+  //whole samples go as an int, so the view stays exact past float precision
+  Val first = glm::floor(v.first);
+  s.Uniforms("offsets", d.offsets(), "levels", d.levels(), "count", d.size(), "columns", cast<uint>(columns), "first", cast<int>(first),
+             "rect", vec4(m_pos, m_size) * vec4(aspect, aspect), "view", vec4(v.first - first, v.count, v.min, v.max),
+             "clip_idx", cast<int>(ClipTable::slot(m_clip)), "pixel", 1. / window.size().y, "level", cast<double>(m_level), "color", m_color);
+
+  GLbind(tex, 0);
+  GLbind(s_vao).DrawArrays(cast<uint>(range.x) * 2, cast<uint>(range.y - range.x) * 2, GL_TRIANGLE_STRIP);
+}
+
+bool Text::batchable(Text const&t)const
+{
+  return t.m_run->font->tex() == m_run->font->tex();
+}
 
 void Text::Draw(GLbindingVao const&b, GLushort num, GLushort offset)const
 {
-  static const GLshader s_s = []{ GLshader s = { "gui__pos_col_tex_vs", "gui_sdf_ps" }; GLbind(s).Uniform("src", 0); return s; }();
-  GLbind(s_s);
-  GLbind(m_font->tex(), 0);
+  static const GLshader s_s = []{ GLshader s = { "gui__pos_col_tex_vs", "gui_sdf_ps" }; auto b = GLbind(s); b.Uniforms("src", 0, "pages", GlyphPages::unit, "colors", ColorTable::unit, "tweens", TweenTable::unit); b.UniformBlock("Clips", ClipTable::binding); b.UniformBlock("FrameConstants", TweenTable::binding); return s; }();
+  GLbind(s_s).Uniform("msdf", m_run->font->msdf() ? 1 : 0);
+  //fonts without an atlas only sample the glyph cache pages, src just needs some texture bound
+  static const GLtex2d s_no_atlas(1, 1, 1);
+  Val atlas = m_run->font->tex();
+  GLbind(atlas ? *atlas : s_no_atlas, 0);
+  if(Val pages = GlyphCache::Get().tex())
+    GLbind(*pages, GlyphPages::unit);
   b.DrawOffset(num, offset);
 }
 
 
-vec4 Obj::bounding_box()const
+float Tween::progress(double time)const
+{
+  Val t = glm::clamp(cast<float>(time - start) / glm::max(duration, 1e-6f), 0.f, 1.f);
+  switch(ease)
+  {
+    case Ease::Linear: return t;
+    case Ease::In:     return t * t;
+    case Ease::Out:    return t * (2 - t);
+    case Ease::InOut:  return t * t * (3 - 2 * t);
+  }
+  return t;
+}
+
+vec4 Tween::color(double time)const
 {
-  Val crop1 = vec2(m_crop.x, m_crop.y)
-      , crop2 = vec2(m_crop.z, m_crop.w)
-      , xy1 = glm::clamp(m_pos, crop1, crop2)
-      , xy2 = glm::clamp(m_pos + m_size, crop1, crop2);
+  return glm::mix(color_from, color_to, progress(time));
+}
 
-  return { xy1, xy2 };
+bool Tween::operator==(Tween const&r)const
+{
+  return colored == r.colored && color_from == r.color_from && color_to == r.color_to &&
+      offset_from == r.offset_from && offset_to == r.offset_to &&
+      scale_from == r.scale_from && scale_to == r.scale_to &&
+      start == r.start && duration == r.duration && ease == r.ease;
+}
+
+
+vec4 Obj::bounding_box()const
+{
+  return { m_pos, m_pos + m_size };
 }
 
 bool Obj::intersect(Obj const&r)const
@@ -222,11 +411,11 @@ bool Obj::intersect(Obj const&r)const
            bb.w <= r_bb.y || bb.y >= r_bb.w);
 }
 
-Obj::Obj(Vec4 crop, Vec2 pos, Vec2 size, Vec4 color)
+Obj::Obj(uint clip, Vec2 pos, Vec2 size, Vec4 color)
   : m_pos(pos)
   , m_size(glm::max(vec2(0), size))
   , m_color(color)
-  , m_crop(crop)
+  , m_clip(clip)
 { }
 
 
@@ -235,52 +424,89 @@ static bool equalColor(Vec4 l, Vec4 r)
   return glm::all(glm::epsilonEqual(l, r, vec4(1. / 256)));
 }
 
-uint Rect::compare(Vec4 crop, Vec2 pos, Vec2 size, Vec4 color)const
+uint Rect::compare(uint clip, Vec2 pos, Vec2 size, Vec4 color)const
 {
   if(!opaque(color) != this->ordered())
     return State::mismatch;
 
   Val window = Window::Get();
   return (window.equalPos(vec4(m_pos, m_size), vec4(pos, size)) &&
-          window.equalPos(m_crop, crop) ? 0u : State::xyzw)
+          m_clip == clip ? 0u : State::xyzw)
       | (equalColor(m_color, color) ? 0u : State::rgba);
 }
 
-uint Sprite::compare(Vec4 crop, Vec2 pos, Vec2 size, struct Vtex const*tex, Vec4 color)const
+uint Sprite::compare(uint clip, Vec2 pos, Vec2 size, struct Vtex const*tex, Vec4 color)const
 {
   if(m_atlas_idx != tex->tex->obj())
     return State::mismatch;
 
   Val window = Window::Get();
-  Val same_crop = window.equalPos(m_crop, crop);
-  return (same_crop &&
+  return (m_clip == clip &&
           window.equalPos(vec4(m_pos, m_size), vec4(pos, size)) ? 0u : State::xyzw)
-      | (same_crop &&
-         m_tex == tex ? 0u : State::uv)
+      | (m_tex == tex ? 0u : State::uv)
       | (equalColor(m_color, color) ? 0u : State::rgba);
 }
 
-/*uint 9Sprite::compare(Vec4 crop, Vec2 pos, Vec2 size, float corner, uint theme, Vec4 color)const
+uint Plot::compare(uint clip, Vec2 pos, Vec2 size, PlotData const*data, Vec4 color)const
 {
-  return (equalPos(vec4(m_pos, m_size), vec4(pos, size)) &&
-          equalSize(m_corner, corner) &&
-          m_theme == theme &&
-          equalPos(m_crop, crop) ? 0u : State::xyzw)//coord too
+  Val window = Window::Get();
+  return (m_data == data ? 0u : State::mismatch)
+      | (window.equalPos(vec4(m_pos, m_size), vec4(pos, size)) &&
+         m_clip == clip ? 0u : State::xyzw)
       | (equalColor(m_color, color) ? 0u : State::rgba);
-}*/
+}
 
-uint Text::compare(Vec4 crop, Vec2 pos, String text, Font const*font, float scale, Vec4 color)const
+uint Frame::compare(uint clip, Vec2 pos, Vec2 size, uint style, Vec4 color)const
 {
   Val window = Window::Get();
-  return (window.equalPos(m_pos, pos) &&
-          m_text == text &&
-          m_font == font &&
-          window.equalPos(m_scale, scale) &&
-          window.equalPos(m_crop, crop) ? 0u : State::xyzw | State::uv)
+  return (window.equalPos(vec4(m_pos, m_size), vec4(pos, size)) &&
+          m_clip == clip &&
+          m_style == style ? 0u : State::xyzw)
+      | (equalColor(m_color, color) ? 0u : State::rgba);
+}
+
+uint Text::compare(uint clip, Vec2 pos, String text, Font const*font, float scale, Vec4 color)const
+{
+  Val window = Window::Get();
+  Val same_layout = m_run->text.str() == text &&
+      m_run->font == font &&
+      window.equalPos(m_scale, scale) &&
+      !m_run->stale();
+  Val same_place = window.equalPos(m_pos, pos) &&
+      m_clip == clip;
+  return (!same_layout ? State::xyzw | State::uv : !same_place ? State::xyzw | State::translated : 0u)
+      | (equalColor(m_color, color) ? 0u : State::rgba);
+}
+
+uint Text::compare(uint clip, Vec2 pos, Interned const&text, Font const*font, float scale, Vec4 color)const
+{
+  Val window = Window::Get();
+  Val same_layout = m_run->text == text &&
+      m_run->font == font &&
+      window.equalPos(m_scale, scale) &&
+      !m_run->stale();
+  Val same_place = window.equalPos(m_pos, pos) &&
+      m_clip == clip;
+  return (!same_layout ? State::xyzw | State::uv : !same_place ? State::xyzw | State::translated : 0u)
       | (equalColor(m_color, color) ? 0u : State::rgba);
 }
 
 
+static void setMeta(Obj::it<uint16> xyzw, uint verts, uint clip, uint style=0)
+{
+  Val meta = cast<uint16>(ClipTable::slot(clip) << 4 | style);
+  for(uint i=0; i<verts; ++i)
+    xyzw[i * 4 + 3] = meta;
+}
+
+static void packQuad(float level, Vec4 bb, Obj::it<uint16> xyzw, uint clip, uint style=0)
+{
+  Val quad = array<float, 16>{{ bb.x, bb.y, level, 0,  bb.z, bb.y, level, 0,
+                                bb.z, bb.w, level, 0,  bb.x, bb.w, level, 0 }};
+  PackHalf(quad.data(), &*xyzw, quad.size());
+  setMeta(xyzw, 4, clip, style);
+}
+
 void Rect::genMesh(float level, uint state, it<uint16> xyzw, it<ubyte> rgba, it<uint16> uv)const
 {
   if(state & State::xyzw)
@@ -288,14 +514,7 @@ void Rect::genMesh(float level, uint state, it<uint16> xyzw, it<ubyte> rgba, it<
     Val aspect = Window::Get().aspect();
     Val bb = this->bounding_box() * vec4(aspect, aspect);
 
-    Val z = packHalf1x16(level)
-        , x1 = packHalf1x16(bb.x)
-        , x2 = packHalf1x16(bb.z)
-        , y1 = packHalf1x16(bb.y)
-        , y2 = packHalf1x16(bb.w);
-
-    copy(xyzw, array<uint16, 16>{ x1, y1, z, 0,  x2, y1, z, 0,
-                                  x2, y2, z, 0,  x1, y2, z, 0 });
+    packQuad(level, bb, xyzw, m_clip);
   }
 
   if(state & State::rgba)
@@ -328,14 +547,7 @@ void Sprite::genMesh(float level, uint state, it<uint16> xyzw, it<ubyte> rgba, i
     Val aspect = Window::Get().aspect();
     Val bb = this->bounding_box() * vec4(aspect, aspect);
 
-    Val z = packHalf1x16(level)
-        , x1 = packHalf1x16(bb.x)
-        , x2 = packHalf1x16(bb.z)
-        , y1 = packHalf1x16(bb.y)
-        , y2 = packHalf1x16(bb.w);
-
-    copy(xyzw, array<uint16, 16>{ x1, y1, z, 0,  x2, y1, z, 0,
-                                  x2, y2, z, 0,  x1, y2, z, 0 });
+    packQuad(level, bb, xyzw, m_clip);
   }
 
   if(state & State::rgba)
@@ -353,65 +565,58 @@ void Sprite::genMesh(float level, uint state, it<uint16> xyzw, it<ubyte> rgba, i
   if(state & State::uv)
   {
     Val coord = m_tex->coord;
-    Val u1 = packHalf1x16(coord.x)
-        , u2 = packHalf1x16(coord.z)
-        , v1 = packHalf1x16(coord.y)
-        , v2 = packHalf1x16(coord.w);
-    copy(uv, array<uint16, 8>{ u1, v1,  u2, v1,
-                               u2, v2,  u1, v2 });//scale
+    Val quad = array<float, 8>{{ coord.x, coord.y,  coord.z, coord.y,
+                                 coord.z, coord.w,  coord.x, coord.w }};//scale
+    PackHalf(quad.data(), &*uv, quad.size());
   }
 }
 
-Sprite::Sprite(Vec4 crop, Vec2 pos, Vec2 size, Vtex const*tex, Vec4 color)
-  : Obj(crop, pos, size, color)
+Sprite::Sprite(uint clip, Vec2 pos, Vec2 size, Vtex const*tex, Vec4 color)
+  : Obj(clip, pos, size, color)
   , m_atlas_idx(tex->tex->obj())
   , m_tex(tex)
 { }
 
 
-/*void 9Sprite::genMesh(float level, uint state, it<uint16> xyzw, it<ubyte> rgba, it<uint16> uv)const //reimplement as unified sdf shader
+void Plot::genMesh(float level, uint, it<uint16>, it<ubyte>, it<uint16>)const
+{
+  m_level = level;
+}
+
+
+static vector<vec4>& frameStyles()
+{
+  static vector<vec4> s_styles = { vec4(0), vec4(6, 1, 0, 0.6), vec4(6, 1, 8, 0.6), vec4(12, 0, 16, 1) };
+  return s_styles;
+}
+
+vector<vec4> const& Frame::styles()
+{
+  return frameStyles();
+}
+
+uint Frame::AddStyle(Vec4 style)
 {
-  CASSERT(!themes_file.empty(), "9Sprite component needs themes_file");
-  static uint total_themes = []{ return GLtex::FromResource(ResourceLoader::Load(themes_file.c_str()), 4).height(); }();
+  auto &styles = frameStyles();
+  CASSERT(styles.size() < max_styles, "Frame style table overflow");
+  if(styles.size() >= max_styles)
+    return Plain;
+
+  styles.emplace_back(style);
+  return cast<uint>(styles.size() - 1);
+}
+
+void Frame::genMesh(float level, uint state, it<uint16> xyzw, it<ubyte> rgba, it<uint16> uv)const
+{
+  CASSERT(m_style < styles().size(), "Frame style out of range");
 
   if(state & State::xyzw)
   {
-    Val m1 = vec2(glm::min(m_size.x, m_size.y) * glm::min(0.5f, m_corner))
-        , m2 =  m_size - m1
-        , crop1 = vec2(m_crop.x, m_crop.y)
-        , crop2 = vec2(m_crop.z, m_crop.w)
-        , size = m_pos + m_size;
-
-    Val wh = vec2(1) / m_size
-        , uv1 = wh * (crop1 - m_pos) * vec2(glm::greaterThan(crop1, m_pos))
-        , uv2 = wh * (size - crop2) * vec2(glm::lessThan(crop2, size));
-
-    Val xy1 = glm::clamp(m_pos, crop1, crop2)
-        , xy2 = glm::clamp(m_pos + m_size, crop1, crop2)
-        , m1xy = glm::clamp(m_pos + m1, crop1, crop2)
-        , m2xy = glm::clamp(m_pos + m2, crop1, crop2);
-
-    Val z = packHalf1x16(level)
-        , x1 = packHalf1x16(xy1.x)
-        , y1 = packHalf1x16(xy1.y)
-        , x2 = packHalf1x16(xy2.x)
-        , y2 = packHalf1x16(xy2.y)
-        , m1x = packHalf1x16(m1xy.x)
-        , m1y = packHalf1x16(m1xy.y)
-        , m2x = packHalf1x16(m2xy.x)
-        , m2y = packHalf1x16(m2xy.y)
-        , t = packHalf1x16(glm::clamp((double(m_theme) + 0.5) / total_themes, 0., 1.));
-
-    copy(xyzw, array<uint16, 64>{ x1, y1,  z, t,  m1x, y1,  z, t,  m2x, y1,  z, t,  x2, y1,  z, t,
-                                  x1, m1y, z, t,  m1x, m1y, z, t,  m2x, m1y, z, t,  x2, m1y, z, t,
-                                  x1, m2y, z, t,  m1x, m2y, z, t,  m2x, m2y, z, t,  x2, m2y, z, t,
-                                  x1, y2,  z, t,  m1x, y2,  z, t,  m2x, y2,  z, t,  x2, y2,  z, t });
-
-    static const GLushort n = packHalf1x16(0), o = packHalf1x16(1);
-    copy(uv, array<uint16, 32>{ o, o,  n, o,  n, o,  o, o,
-                                o, n,  n, n,  n, n,  o, n,
-                                o, n,  n, n,  n, n,  o, n,
-                                o, o,  n, o,  n, o,  o, o });
+    Val window = Window::Get();
+    Val margin = styles()[m_style].z * 2.f / (window.size() * window.aspect());
+    Val q1 = (m_pos - margin) * window.aspect()
+        , q2 = (m_pos + m_size + margin) * window.aspect();
+    packQuad(level, vec4(q1, q2), xyzw, m_clip, m_style);
   }
 
   if(state & State::rgba)
@@ -422,64 +627,55 @@ Sprite::Sprite(Vec4 crop, Vec2 pos, Vec2 size, Vtex const*tex, Vec4 color)
         , b = color.b
         , a = color.a;
 
-    copy(rgba, array<ubyte, 64>{ r, g, b, a,  r, g, b, a,  r, g, b, a,  r, g, b, a,
-                                 r, g, b, a,  r, g, b, a,  r, g, b, a,  r, g, b, a,
-                                 r, g, b, a,  r, g, b, a,  r, g, b, a,  r, g, b, a,
-                                 r, g, b, a,  r, g, b, a,  r, g, b, a,  r, g, b, a });
+    copy(rgba, array<ubyte, 16>{ r, g, b, a,  r, g, b, a,
+                                 r, g, b, a,  r, g, b, a });
+  }
+
+  if(state & State::uv)
+  {
+    Val n = packHalf1x16(1), m = packHalf1x16(-1);
+    copy(uv, array<uint16, 8>{ m, m,  n, m,  n, n,  m, n });
   }
-}*/
+}
 
 
 void Text::genMesh(float level, uint state, it<uint16> xyzw, it<ubyte> rgba, it<uint16> uv)const
 {
-  if(state & State::xyzw ||
-     state & State::uv)
+  if((state & State::xyzw ||
+      state & State::uv) &&
+     !m_run->glyphs.empty())
   {
-    Val s = m_scale / (m_font->topline() - m_font->bottomline());
-    Val z = packHalf1x16(level);
-    Val pos = m_pos + vec2(0, -m_font->bottomline()) * s
-        , crop1 = vec2(m_crop.x, m_crop.y)
-        , crop2 = vec2(m_crop.z, m_crop.w);
+    //only the 8 distinct corner/uv values of a glyph are converted, quads are then assembled from the halves
+    static vector<float> s_corners;
+    static vector<uint16> s_halves;
+    Val glyphs = m_run->glyphs;
+    s_corners.resize(glyphs.size() * 8);
+    s_halves.resize(s_corners.size());
 
-    float x = !m_text.empty() ? -m_font->charData(utf8::unchecked::peek_next(m_text.cbegin())).x1 : 0;
+    Val aspect = Window::Get().aspect();
+    Val s = m_scale * m_run->norm * vec4(aspect, aspect)
+        , origin = vec4(m_pos * aspect, m_pos * aspect);
 
-    uint last_char = 0;
-    for(auto i=m_text.begin(); i!=m_text.cend();)
+    auto f = s_corners.data();
+    for(Val g: glyphs)
+    {
+      Val xy = origin + s * g.xy;
+      f = std::copy(&g.uv.x, &g.uv.x + 4, std::copy(&xy.x, &xy.x + 4, f));
+    }
+
+    PackHalf(s_corners.data(), s_halves.data(), s_corners.size());
+
+    Val moved = state & State::translated;
+    Val z = packHalf1x16(level);
+    auto h = s_halves.cbegin();
+    for(Val g: glyphs)
     {
-      Val code = utf8::unchecked::next(i);
-      Val c = m_font->charData(code);
-      x += m_font->kerning(last_char, code);
-      last_char = code;
-
-      if(!c.empty)
-      {
-        vec2 xy1 = pos + s * vec2(x + c.x1, c.y1)
-            , xy2 = pos + s * vec2(x + c.x2, c.y2);
-
-        Val wh = vec2(c.u2 - c.u1, c.v2 - c.v1) / (xy2 - xy1)
-            , uv1 = wh * (crop1 - xy1) * vec2(glm::greaterThan(crop1, xy1))
-            , uv2 = wh * (xy2 - crop2) * vec2(glm::lessThan(crop2, xy2));
-
-        Val aspect = Window::Get().aspect();
-
-        xy1 = glm::clamp(xy1, crop1, crop2) * aspect;
-        xy2 = glm::clamp(xy2, crop1, crop2) * aspect;
-
-        Val x1 = packHalf1x16(xy1.x)
-            , x2 = packHalf1x16(xy2.x)
-            , y1 = packHalf1x16(xy1.y)
-            , y2 = packHalf1x16(xy2.y)
-            , u1 = packHalf1x16(c.u1 + uv1.x)
-            , u2 = packHalf1x16(c.u2 - uv2.x)
-            , v1 = packHalf1x16(c.v1 + uv1.y)
-            , v2 = packHalf1x16(c.v2 - uv2.y);
-
-        xyzw = copy(xyzw, array<uint16, 16>{ x1, y1, z, 0,  x2, y1, z, 0,
-                                             x2, y2, z, 0,  x1, y2, z, 0 });
-        uv = copy(uv, array<uint16, 8>{ u1, v1,  u2, v1,  u2, v2,  u1, v2 });
-      }
-
-      x += c.adv;
+      Val m = cast<uint16>(ClipTable::slot(m_clip) << 4 | g.page);
+      xyzw = copy(xyzw, array<uint16, 16>{{ h[0], h[1], z, m,  h[2], h[1], z, m,
+                                            h[2], h[3], z, m,  h[0], h[3], z, m }});
+      if(!moved)
+        uv = copy(uv, array<uint16, 8>{{ h[4], h[5],  h[6], h[5],  h[6], h[7],  h[4], h[7] }});
+      h += 8;
     }
   }
 
@@ -493,6 +689,18 @@ void Text::genMesh(float level, uint state, it<uint16> xyzw, it<ubyte> rgba, it<
   }
 }
 
+Text Text::Make(uint clip, Vec2 pos, String text, Font const*font, float scale, Vec4 color)
+{
+  return Make(clip, pos, Interned(text), font, scale, color);
+}
+
+Text Text::Make(uint clip, Vec2 pos, Interned const&text, Font const*font, float scale, Vec4 color)
+{
+  auto run = GlyphRun::Get(text, font);
+  Val size = text.str().empty() ? vec2(0) : vec2(run->width * run->norm * scale, scale);
+  return { clip, pos, size, move(run), scale, color };
+}
+
 pair<vec2, uint> Text::GetSizeFor(String text, Font const*font, float scale, float max_width, int max_glyphs)
 {
   if(text.empty())
@@ -500,13 +708,25 @@ pair<vec2, uint> Text::GetSizeFor(String text, Font const*font, float scale, flo
 
   CASSERT(utf8::is_valid(text.cbegin(), text.cend()), "Non-utf8 string");
 
+  if(max_width < -0.5 && max_glyphs < 0)
+    if(Val run = GlyphRun::Find(text, font))
+      return { vec2(run->width * run->norm * scale, scale), cast<uint>(run->glyphs.size()) };
+
+  return GetSizeFor(text.data(), text.data() + text.size(), font, scale, max_width, max_glyphs);
+}
+
+pair<vec2, uint> Text::GetSizeFor(char const*begin, char const*end, Font const*font, float scale, float max_width, int max_glyphs)
+{
+  if(begin == end)
+    return { vec2(0), 0 };
+
   Val with_empty = max_width > -0.5 || max_glyphs > -1;
   Val s = scale / (font->topline() - font->bottomline());
-  float w = -font->charData(utf8::unchecked::peek_next(text.cbegin())).x1;
+  float w = -font->charData(utf8::unchecked::peek_next(begin)).x1;
   uint g = 0;
 
   uint last_char = 0;
-  for(auto i=text.begin(); i!=text.cend();)
+  for(auto i=begin; i!=end;)
   {
     Val code = utf8::unchecked::next(i);
     Val c = font->charData(code);
@@ -532,3 +752,201 @@ pair<vec2, uint> Text::GetSizeFor(String text, Font const*font, float scale, flo
 
   return { vec2(w * s, scale), g };
 }
+
+
+Advances::Advances(String text, Font const*font)
+  : m_height(font->topline() - font->bottomline())
+{
+  CASSERT(utf8::is_valid(text.cbegin(), text.cend()), "Non-utf8 string");
+
+  float w = text.empty() ? 0 : -font->charData(utf8::unchecked::peek_next(text.cbegin())).x1;
+  m_x.emplace_back(w);
+
+  uint last_char = 0;
+  for(auto i=text.begin(); i!=text.cend();)
+  {
+    Val code = utf8::unchecked::next(i);
+    Val c = font->charData(code);
+    w += c.adv + font->kerning(last_char, code);
+
+    m_x.emplace_back(w);
+    m_reach.emplace_back(m_reach.empty() ? w : glm::max(m_reach.back(), w));
+    m_tail.emplace_back(c.empty ? 0 : c.x2 - c.adv);
+    last_char = code;
+  }
+}
+
+float Advances::width(uint glyphs, float scale)const
+{
+  if(!built())
+    return 0;
+
+  Val n = glm::min(glyphs, this->glyphs());
+  return (m_x[n] + (n ? m_tail[n - 1] : 0)) * (scale / m_height);
+}
+
+uint Advances::fit(float max_width, float scale)const
+{
+  Val s = scale / m_height;
+  Val found = std::upper_bound(m_reach.cbegin(), m_reach.cend(), max_width, [s](float w, float x){ return x * s > w; });
+  return cast<uint>(found - m_reach.cbegin());
+}
+
+
+Interned::Interned(String str)
+  : m_e(lookup(str, true))
+{ }
+
+Interned Interned::Find(String str)
+{
+  Interned i;
+  i.m_e = lookup(str, false);
+  return i;
+}
+
+shared_ptr<const Interned::Entry> Interned::lookup(String str, bool add)
+{
+  //leaked, so handles held by statics can still unregister themselves at exit
+  static auto &s_table = *new unordered_map<string8, weak_ptr<const Entry>>;
+  static uint s_next_id = 0;
+
+  if(!add)
+  {
+    Val found = s_table.find(str);
+    return found == s_table.cend() ? nullptr : found->second.lock();
+  }
+
+  Val slot = s_table.emplace(str, weak_ptr<const Entry>()).first;
+  if(auto e = slot->second.lock())
+    return e;
+
+  shared_ptr<const Entry> entry(new Entry{ &slot->first, std::hash<string8>()(str), ++s_next_id }, [](Entry const*e){
+    s_table.erase(*e->str);
+    delete e;
+  });
+  slot->second = entry;
+  return entry;
+}
+
+String Interned::str()const
+{
+  static const string8 s_empty;
+  return m_e ? *m_e->str : s_empty;
+}
+
+
+namespace
+{
+struct RunKey
+{
+  uint id;
+  Font const*font;
+  bool operator==(RunKey const&r)const { return id == r.id && font == r.font; }
+};
+
+struct RunKeyHash
+{
+  size_t operator()(RunKey const&k)const { return std::hash<uint>()(k.id) ^ (std::hash<Font const*>()(k.font) << 1); }
+};
+}
+
+static shared_ptr<GlyphRun> layoutRun(Interned const&interned, Font const*font)
+{
+  auto run = make_shared<GlyphRun>(GlyphRun{ interned, font, {}, 0, 1.f / (font->topline() - font->bottomline()), false, GlyphCache::Get().epoch(), 0 });
+  Val text = interned.str();
+  if(text.empty())
+    return run;
+
+  CASSERT(utf8::is_valid(text.cbegin(), text.cend()), "Non-utf8 string");
+
+  Val base = -font->bottomline();
+  float x = -font->charData(utf8::unchecked::peek_next(text.cbegin())).x1;
+
+  uint last_char = 0;
+  for(auto i=text.begin(); i!=text.cend();)
+  {
+    Val code = utf8::unchecked::next(i);
+    Val c = font->charData(code);
+    x += font->kerning(last_char, code);
+    last_char = code;
+
+    run->dynamic |= c.page != Font::CharData::atlas;
+    if(c.page != Font::CharData::atlas && c.page != Font::CharData::pending)
+      run->pages |= 1u << (c.page - 1u);
+    if(!c.empty && c.page != Font::CharData::pending)
+      run->glyphs.push_back({ vec4(x + c.x1, c.y1 + base, x + c.x2, c.y2 + base), c.uv(), c.page });
+
+    x += c.adv;
+  }
+
+  Val c = font->charData(last_char);
+  run->width = c.empty ? x : x + c.x2 - c.adv;
+  return run;
+}
+
+uint GlyphRun::capacity = 1024;
+
+bool GlyphRun::stale()const
+{
+  if(!dynamic)
+    return false;
+
+  auto &cache = GlyphCache::Get();
+  for(uint i=0; i<GlyphCache::pages; ++i)
+    if(pages & (1u << i))
+      cache.Touch(i);
+
+  return epoch != cache.epoch();
+}
+
+namespace
+{
+struct RunCache
+{
+  using lru_list = std::list<pair<RunKey, shared_ptr<const GlyphRun>>>;
+  lru_list lru;
+  unordered_map<RunKey, lru_list::iterator, RunKeyHash> map;
+
+  static RunCache& Get() { static RunCache s_cache; return s_cache; }
+};
+}
+
+shared_ptr<const GlyphRun> GlyphRun::Get(Interned const&text, Font const*font)
+{
+  auto &c = RunCache::Get();
+  RunKey key = { text.id(), font };
+  Val found = c.map.find(key);
+  if(found != c.map.cend())
+  {
+    c.lru.splice(c.lru.begin(), c.lru, found->second);
+    auto &run = found->second->second;
+    if(run->stale())
+      run = layoutRun(text, font);
+    return run;
+  }
+
+  c.lru.emplace_front(key, layoutRun(text, font));
+  c.map.emplace(move(key), c.lru.begin());
+
+  while(c.lru.size() > capacity)
+  {
+    c.map.erase(c.lru.back().first);
+    c.lru.pop_back();
+  }
+
+  return c.lru.front().second;
+}
+
+shared_ptr<const GlyphRun> GlyphRun::Find(String text, Font const*font)
+{
+  Val interned = Interned::Find(text);
+  if(!interned)
+    return nullptr;
+
+  Val c = RunCache::Get();
+  Val found = c.map.find({ interned.id(), font });
+  if(found == c.map.cend() || found->second->second->stale())
+    return nullptr;
+
+  return found->second->second;
+}
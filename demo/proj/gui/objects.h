@@ -4,6 +4,7 @@
 #include <glm/vec4.hpp>
 
 namespace code_policy { struct GLbindingVao; struct Vtex; struct Font; }
+namespace GUI { struct PlotData; }
 
 namespace GUI
 {
@@ -12,10 +13,62 @@ typedef string const& String;
 typedef vec2 const&   Vec2;
 typedef vec4 const&   Vec4;
 
+struct Interned
+{
+  Interned() = default;
+  explicit Interned(String str);
+  static Interned Find(String str); //empty unless str is already interned
+
+  explicit operator bool()const { return !!m_e; }
+  String str()const;
+  uint id()const     { return m_e ? m_e->id : 0;   }
+  size_t hash()const { return m_e ? m_e->hash : 0; }
+
+  bool operator==(Interned const&r)const { return m_e == r.m_e; }
+  bool operator!=(Interned const&r)const { return m_e != r.m_e; }
+
+private:
+  struct Entry { string8 const*str; size_t hash; uint id; };
+  static shared_ptr<const Entry> lookup(String str, bool add);
+  shared_ptr<const Entry> m_e;
+};
+
 struct State { enum : uint { resized = 0x1, mismatch = 0x2,
-                             xyzw = 0x10, rgba = 0x20, uv = 0x30,
+                             xyzw = 0x10, rgba = 0x20, translated = 0x40, uv = 0x80,
                              full = xyzw | rgba | uv | resized }; };
 
+//clips past the table size go to further pages of it, a batch only holds objects from one page
+struct ClipTable { enum : uint { binding = 0, size = 1024 };
+                   static uint page(uint clip) { return clip / size; }
+                   static uint slot(uint clip) { return clip % size; } };
+//vertices carry the object index within a page of the colour/tween tables, a batch only holds objects from one page
+struct SlotTable { enum : uint { size = 0x10000 };
+                   static uint page(uint i) { return i / size; }
+                   static uint slot(uint i) { return i % size; } };
+struct ColorTable { enum : uint { unit = 1, flag = 0x8000 }; };
+struct TweenTable { enum : uint { unit = 2, binding = 1, flag = 0x4000, stride = 5 }; };
+struct GlyphPages { enum : uint { unit = 3 }; };
+
+struct Tween
+{
+  enum class Ease : uint { Linear, In, Out, InOut };
+
+  //colour endpoints replace the vertex colour only when colored is set, offset/scale tweens keep it
+  vec4 color_from = vec4(1), color_to = vec4(1);
+  bool colored = false;
+  vec2 offset_from = vec2(0), offset_to = vec2(0);
+  float scale_from = 1, scale_to = 1;
+  double start = 0; //Renderer::time()
+  float duration = 0;
+  Ease ease = Ease::InOut;
+
+  float progress(double time)const;
+  vec4 color(double time)const;
+
+  bool operator==(Tween const&r)const;
+  bool operator!=(Tween const&r)const { return !(*this == r); }
+};
+
 struct Obj
 {
   struct Anchor { enum : uint { H = 0xf, Left = 0x0, Middle = 0x1, Right = 0x2,
@@ -24,6 +77,8 @@ struct Obj
   virtual ~Obj() = default;
 
   Val size()const { return m_size; }
+  Val color()const { return m_color; }
+  uint clip()const { return m_clip; }
   vec4 bounding_box()const;
   bool intersect(Obj const&)const;
 
@@ -32,41 +87,47 @@ struct Obj
   virtual bool ordered()const    { return !opaque(m_color); }
   virtual vector<uint16> genIdx(uint, uint)const;
 
-  virtual void Draw(GLbindingVao const&, uint16, uint16)const;
+  virtual void Draw(GLbindingVao const&, uint16, uint16)const = 0;
 
   template<class T> using it = typename vector<T>::iterator;
   virtual void genMesh(float, uint, it<uint16>, it<ubyte>, it<uint16>)const = 0;
 
-  virtual uint compare(Vec4, Vec2, Vec2,                       Vec4=vec4(1))const { return State::mismatch; }
-  virtual uint compare(Vec4, Vec2, Vec2, String,               Vec4=vec4(1))const { return State::mismatch; }
-  virtual uint compare(Vec4, Vec2, Vec2, Vtex const*,          Vec4=vec4(1))const { return State::mismatch; }
-  //  virtual uint compare(Vec4, Vec2, Vec2, float, uint,          Vec4=vec4(1))const { return State::mismatch; }
-  virtual uint compare(Vec4, Vec2, String, Font const*, float, Vec4=vec4(1))const { return State::mismatch; }
+  virtual uint compare(uint, Vec2, Vec2,                       Vec4=vec4(1))const { return State::mismatch; }
+  virtual uint compare(uint, Vec2, Vec2, String,               Vec4=vec4(1))const { return State::mismatch; }
+  virtual uint compare(uint, Vec2, Vec2, Vtex const*,          Vec4=vec4(1))const { return State::mismatch; }
+  virtual uint compare(uint, Vec2, Vec2, uint,                 Vec4=vec4(1))const { return State::mismatch; }
+  virtual uint compare(uint, Vec2, String, Font const*, float, Vec4=vec4(1))const { return State::mismatch; }
+  virtual uint compare(uint, Vec2, Interned const&, Font const*, float, Vec4=vec4(1))const { return State::mismatch; }
+  virtual uint compare(uint, Vec2, Vec2, PlotData const*,      Vec4=vec4(1))const { return State::mismatch; }
 
   virtual bool batchable(struct Rect const&)const   { return false; }
   virtual bool batchable(struct Sprite const&)const { return false; }
-  //virtual bool batchable(struct 9Sprite const&)const  { return false; }
+  virtual bool batchable(struct Frame const&)const  { return false; }
   virtual bool batchable(struct Text const&)const   { return false; }
   virtual bool check_batchable(Obj const&)const = 0;
 
 protected:
-  Obj(Vec4 crop, Vec2 pos, Vec2 size, Vec4 color);
+  Obj(uint clip, Vec2 pos, Vec2 size, Vec4 color);
   vec2 m_pos, m_size;
-  vec4 m_color, m_crop;
+  vec4 m_color;
+  uint m_clip;
 };
 
 
 struct Rect : Obj
 {
+  void Draw(GLbindingVao const&, uint16, uint16)const;
+
   void genMesh(float, uint, it<uint16>, it<ubyte>, it<uint16>)const;
 
-  uint compare(Vec4, Vec2, Vec2, Vec4=vec4(1))const;
+  uint compare(uint, Vec2, Vec2, Vec4=vec4(1))const;
 
-  bool batchable(Rect const&r)const { return r.ordered() == this->ordered(); }
+  bool batchable(Rect const&r)const  { return r.ordered() == this->ordered(); }
+  bool batchable(Frame const&)const  { return this->ordered();                }
   bool check_batchable(Obj const&r)const { return r.batchable(*this); }
 
-  static Rect Make(Vec4 crop, Vec2 pos, Vec2 size, Vec4 color=vec4(1))
-  { return { crop, pos, size, color }; }
+  static Rect Make(uint clip, Vec2 pos, Vec2 size, Vec4 color=vec4(1))
+  { return { clip, pos, size, color }; }
 private:
   using Obj::Obj;
 };
@@ -79,47 +140,81 @@ struct Sprite : Obj
 
   void genMesh(float, uint, it<uint16>, it<ubyte>, it<uint16>)const;
 
-  uint compare(Vec4, Vec2, Vec2, Vtex const*, Vec4=vec4(1))const;
+  uint compare(uint, Vec2, Vec2, Vtex const*, Vec4=vec4(1))const;
 
   bool batchable(Sprite const&r)const { return r.m_atlas_idx == m_atlas_idx; }
   bool check_batchable(Obj const&r)const { return r.batchable(*this); }
 
-  static Sprite Make(Vec4 crop, Vec2 pos, Vec2 size, Vtex const*tex, Vec4 color=vec4(1))
-  { return { crop, pos, size, tex, color }; }
+  static Sprite Make(uint clip, Vec2 pos, Vec2 size, Vtex const*tex, Vec4 color=vec4(1))
+  { return { clip, pos, size, tex, color }; }
 private:
-  Sprite(Vec4 crop, Vec2 pos, Vec2 size, Vtex const*tex, Vec4 color);
+  Sprite(uint clip, Vec2 pos, Vec2 size, Vtex const*tex, Vec4 color);
   uint m_atlas_idx;
   Vtex const*m_tex;
 };
 
 
-/*struct 9Sprite : Obj
+struct Frame : Obj
 {
-  uint vert_count()const { return 16;   }
-  bool ordered()const    { return true; }
-  vector<uint16> genIdx(uint, uint)const;
+  enum Style : uint { Plain, Bordered, Raised, Floating, max_styles = 16 };
+  static vector<vec4> const& styles(); //radius, border, shadow in pixels, border shade; 0 is a plain fill
+  static uint AddStyle(Vec4 style);
+
+  bool ordered()const { return true; }
   void Draw(GLbindingVao const&, uint16, uint16)const;
 
   void genMesh(float, uint, it<uint16>, it<ubyte>, it<uint16>)const;
 
-  uint compare(Vec4, Vec2, Vec2, float, uint, Vec4 =vec4(1))const;
+  uint compare(uint, Vec2, Vec2, uint, Vec4=vec4(1))const;
 
-  bool batchable(9Sprite const&)const { return true; }
+  bool batchable(Rect const&r)const  { return r.ordered(); }
+  bool batchable(Frame const&)const  { return true;        }
   bool check_batchable(Obj const&r)const { return r.batchable(*this); }
 
-  static 9Sprite Make(vec4 crop, vec2 pos, vec2 size, float corner, uint theme, vec4 color=vec4(1))
-  { return { move(crop), move(pos), move(size), corner, theme, move(color) }; }
-
-  static string themes_file;
+  static Frame Make(uint clip, Vec2 pos, Vec2 size, uint style, Vec4 color=vec4(1))
+  { return { clip, pos, size, style, color }; }
 private:
-  9Sprite(vec4 crop, vec2 pos, vec2 size, float corner, uint theme, vec4 color)
-    : Obj(move(crop), move(pos), move(size), move(color))
-    , m_theme(theme)
-    , m_corner(corner)
+  Frame(uint clip, Vec2 pos, Vec2 size, uint style, Vec4 color)
+    : Obj(clip, pos, size, color)
+    , m_style(style)
   { }
-  uint m_theme;
-  float m_corner;
-};*/
+  uint m_style;
+};
+
+
+struct GlyphRun
+{
+  struct Glyph { vec4 xy, uv; uint page; };
+
+  Interned text;
+  Font const*font;
+  vector<Glyph> glyphs;
+  float width, norm;
+  bool dynamic; //holds glyphs from the dynamic cache, relaid out whenever the cache epoch moves
+  uint epoch, pages;
+
+  bool stale()const;
+
+  static shared_ptr<const GlyphRun> Get(Interned const&text, Font const*font);
+  static shared_ptr<const GlyphRun> Find(String text, Font const*font); //lookup only, null if not cached or stale
+  static uint capacity;
+};
+
+
+struct Advances
+{
+  Advances() = default;
+  Advances(String text, Font const*font);
+
+  bool built()const  { return !m_x.empty();               }
+  uint glyphs()const { return cast<uint>(m_tail.size()); }
+  float width(uint glyphs, float scale)const;
+  uint fit(float max_width, float scale)const;
+
+private:
+  vector<float> m_x, m_reach, m_tail;
+  float m_height = 1;
+};
 
 
 struct Text : Obj
@@ -130,28 +225,51 @@ struct Text : Obj
 
   void genMesh(float, uint, it<uint16>, it<ubyte>, it<uint16>)const;
 
-  uint compare(Vec4, Vec2, String, Font const*, float, Vec4=vec4(1))const;
+  uint compare(uint, Vec2, String, Font const*, float, Vec4=vec4(1))const;
+  uint compare(uint, Vec2, Interned const&, Font const*, float, Vec4=vec4(1))const;
 
-  bool batchable(Text const&)const { return true; }
+  bool batchable(Text const&t)const;
   bool check_batchable(Obj const&r)const { return r.batchable(*this); }
 
   static pair<vec2, uint> GetSizeFor(String text, Font const*font, float scale, float max_width=-1., int max_glyphs=-1);
-  static Text Make(Vec4 crop, Vec2 pos, String text, Font const*font, float scale, Vec4 color=vec4(1)) {
-    Val size_and_count = GetSizeFor(text, font, scale);
-    return { crop, pos, size_and_count.first, text, font, scale, color, size_and_count.second * 4 };
-  }
+  static pair<vec2, uint> GetSizeFor(char const*begin, char const*end, Font const*font, float scale, float max_width=-1., int max_glyphs=-1);
+  static Text Make(uint clip, Vec2 pos, String text, Font const*font, float scale, Vec4 color=vec4(1));
+  static Text Make(uint clip, Vec2 pos, Interned const&text, Font const*font, float scale, Vec4 color=vec4(1));
 private:
-  Text(Vec4 crop, Vec2 pos, Vec2 size, String text, Font const*font, float scale, Vec4 color, uint vert)
-    : Obj(crop, pos, size, color)
-    , m_vert_c(vert)
+  Text(uint clip, Vec2 pos, Vec2 size, shared_ptr<const GlyphRun> run, float scale, Vec4 color)
+    : Obj(clip, pos, size, color)
+    , m_vert_c(cast<uint>(run->glyphs.size()) * 4)
     , m_scale(scale)
-    , m_font(font)
-    , m_text(move(text))
+    , m_run(move(run))
   { }
   uint m_vert_c;
   float m_scale;
-  Font const*m_font;
-  string8 m_text;
+  shared_ptr<const GlyphRun> m_run;
+};
+
+
+struct Plot : Obj
+{
+  uint vert_count()const { return 0;    }
+  bool ordered()const    { return true; }
+  vector<uint16> genIdx(uint, uint)const { return { }; }
+  void Draw(GLbindingVao const&, uint16, uint16)const;
+
+  void genMesh(float, uint, it<uint16>, it<ubyte>, it<uint16>)const;
+
+  uint compare(uint, Vec2, Vec2, PlotData const*, Vec4=vec4(1))const;
+
+  bool check_batchable(Obj const&r)const { return &r == this; }
+
+  static Plot Make(uint clip, Vec2 pos, Vec2 size, PlotData const*data, Vec4 color=vec4(1))
+  { return { clip, pos, size, data, color }; }
+private:
+  Plot(uint clip, Vec2 pos, Vec2 size, PlotData const*data, Vec4 color)
+    : Obj(clip, pos, size, color)
+    , m_data(data)
+  { }
+  PlotData const*m_data;
+  mutable float m_level = 0;
 };
 
 }
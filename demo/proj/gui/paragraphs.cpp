@@ -0,0 +1,489 @@
+#include "paragraphs.h"
+#include "base_classes/font.h"
+#include "base_classes/policies/window.h"
+#include <utfcpp/utf8.h>
+#include <algorithm>
+
+using namespace GUI;
+
+void Paragraphs::Fenwick::assign(vector<uint64> const&v)
+{
+  tree.assign(v.size() + 1, 0);
+  for(size_t i=0; i<v.size(); ++i)
+    add(i, cast<int64>(v[i]));
+}
+
+void Paragraphs::Fenwick::add(size_t i, int64 d)
+{
+  for(++i; i<tree.size(); i+=i&(~i + 1))
+    tree[i] = cast<uint64>(cast<int64>(tree[i]) + d);
+}
+
+uint64 Paragraphs::Fenwick::prefix(size_t i)const
+{
+  uint64 s = 0;
+  for(; i; i-=i&(~i + 1))
+    s += tree[i];
+  return s;
+}
+
+template<class V> static auto lower(V &paras, size_t i)
+{
+  return std::lower_bound(paras.begin(), paras.end(), i, [](Val p, size_t i){ return p.index < i; });
+}
+
+size_t Paragraphs::Fenwick::find(uint64 v)const
+{
+  size_t at = 0, step = 1;
+  while(step * 2 < tree.size())
+    step *= 2;
+
+  for(; step; step/=2)
+    if(at + step < tree.size() && tree[at + step] <= v)
+    {
+      at += step;
+      v -= tree[at];
+    }
+  return at;
+}
+
+
+Paragraphs::Paragraphs()
+{
+  m_blocks.emplace_back(Block{ 1, 1, 0, {}, {} });
+  reindex();
+}
+
+void Paragraphs::Layout(Font const*font, float scale, float max_width)
+{
+  Val window = Window::Get();
+  if(m_font == font &&
+     window.equalPos(m_scale, scale) &&
+     window.equalPos(m_width, max_width))
+    return;
+
+  m_font = font;
+  m_scale = scale;
+  m_width = max_width;
+  ++m_epoch;
+  m_stale = m_paragraphs;
+  m_next = 0;
+}
+
+void Paragraphs::Update(String text)
+{
+  if(m_plain_revision != m_text.revision())
+  {
+    m_plain = m_text.str();
+    m_plain_revision = m_text.revision();
+  }
+
+  Val old = m_plain;
+  if(text == old)
+    return;
+
+  Val common = cast<size_t>(std::mismatch(text.cbegin(), text.cbegin() + cast<ptrdiff_t>(std::min(text.size(), old.size())), old.cbegin()).first - text.cbegin());
+  Val limit = std::min(text.size(), old.size()) - common;
+  size_t tail = 0;
+  while(tail < limit && text[text.size() - 1 - tail] == old[old.size() - 1 - tail])
+    ++tail;
+
+  auto edited = m_text;
+  edited.Erase(common, old.size() - common - tail);
+  edited.Insert(common, text.data() + common, text.size() - common - tail);
+  Edit(edited, common, old.size() - common - tail, text.size() - common - tail);
+  m_plain = text;
+  m_plain_revision = m_text.revision();
+}
+
+void Paragraphs::Update(TextBuffer const&text)
+{
+  if(text.revision() == m_text.revision())
+    return;
+
+  m_text = text;
+  m_blocks.clear();
+  for(size_t left=text.lines(); left;)
+  {
+    const size_t n = std::min(left, size_t(block_size));
+    m_blocks.push_back(Block{ n, n, 0, {}, {} });
+    left -= n;
+  }
+
+  m_paragraphs = m_stale = text.lines();
+  m_lines = text.lines();
+  m_next = 0;
+  reindex();
+}
+
+void Paragraphs::Edit(TextBuffer const&text, size_t at, size_t erased, size_t inserted)
+{
+  CASSERT(m_text.size() - erased + inserted == text.size(), "Edit doesn't match text");
+
+  Val first = m_text.line_of(at)
+      , last = m_text.line_of(at + erased)
+      , count = text.line_of(at + inserted) - first + 1;
+
+  remove(first, last - first + 1);
+  insert(first, count);
+  m_text = text;
+  m_next = std::min(m_next, first);
+
+  if(m_font &&
+     count <= wrap_budget)
+    for(size_t i=first; i<first+count; ++i)
+      wrap(i);
+}
+
+void Paragraphs::Wrap(uint first_line, uint count)
+{
+  if(!m_font ||
+     !m_stale)
+    return;
+
+  Val first = find_line(first_line).paragraph
+      , last = find_line(std::min(first_line + count, lines() - 1)).paragraph;
+
+  for(size_t i=first; i<=last; ++i)
+    if(stale(i))
+      wrap(i);
+}
+
+bool Paragraphs::Wrap(uint budget)
+{
+  if(!m_font)
+    return false;
+
+  if(m_cached > cache_limit)
+    trim();
+
+  for(; m_stale && budget && m_next<m_paragraphs; ++m_next)
+    if(stale(m_next))
+    {
+      wrap(m_next);
+      --budget;
+    }
+
+  return !m_stale;
+}
+
+uint Paragraphs::paragraph(uint line)const
+{
+  return cast<uint>(find_line(line).paragraph);
+}
+
+bool Paragraphs::wrapped(uint line)const
+{
+  Val l = find_line(line);
+  Val p = peek(l.block, l.index);
+  return p && line - l.first + 1 < p->count();
+}
+
+pair<size_t, size_t> Paragraphs::span(uint line)const
+{
+  Val l = find_line(line);
+  Val p = peek(l.block, l.index);
+  Val i = line - l.first;
+  Val start = m_text.line_start(l.paragraph);
+  Val begin = i ? size_t(p->breaks[i - 1]) : 0
+      , end = p && i < p->breaks.size() ? size_t(p->breaks[i]) : bytes(l.paragraph);
+  return { start + begin, start + end };
+}
+
+string8 Paragraphs::text(uint line)const
+{
+  if(line >= lines())
+    return {};
+
+  Val s = span(line);
+  return m_text.substr(s.first, s.second - s.first);
+}
+
+Interned const& Paragraphs::interned(uint line)const
+{
+  Val l = find_line(line);
+  auto &p = const_cast<Paragraphs*>(this)->materialize(l.block, l.index);
+  if(!p.interned)
+  {
+    p.interned = make_unique<vector<Interned>>(p.count());
+    m_cached += p.breaks.empty();
+  }
+
+  auto &s = (*p.interned)[line - l.first];
+  if(!s)
+    s = Interned(text(line));
+  return s;
+}
+
+float Paragraphs::width(uint line)const
+{
+  Val l = find_line(line);
+  Val p = peek(l.block, l.index);
+  Val i = line - l.first;
+  if(p && i < p->widths.size())
+    return p->widths[i];
+
+  if(!m_font ||
+     line >= lines())
+    return 0;
+
+  Val s = text(line);
+  return Text::GetSizeFor(s.data(), s.data() + s.size(), m_font, m_scale).first.x;
+}
+
+Advances const& Paragraphs::advances(uint line)const
+{
+  Val l = find_line(line);
+  auto &p = const_cast<Paragraphs*>(this)->materialize(l.block, l.index);
+  if(!p.advances)
+  {
+    p.advances = make_unique<vector<Advances>>(p.count());
+    m_cached += p.breaks.empty();
+  }
+
+  auto &a = (*p.advances)[line - l.first];
+  if(!a.built())
+    a = Advances(text(line), m_font);
+  return a;
+}
+
+pair<size_t, size_t> Paragraphs::find_paragraph(size_t p)const
+{
+  if(p >= m_paragraphs)
+    return { m_blocks.size() - 1, m_blocks.back().count };
+
+  Val b = m_block_paras.find(p);
+  return { b, p - m_block_paras.prefix(b) };
+}
+
+Paragraphs::Line Paragraphs::find_line(uint line)const
+{
+  const uint64 l = std::min(uint64(line), m_lines - 1);
+  Val b = m_block_lines.find(l);
+  Val block = m_blocks[b];
+  Val p = m_block_paras.prefix(b);
+  Val first = m_block_lines.prefix(b);
+
+  uint64 extra = 0;
+  for(Val i: block.paras)
+  {
+    Val start = first + i.index + extra;
+    if(l < start)
+      break;
+    if(l < start + i.count())
+      return { p + i.index, cast<uint>(start), b, i.index };
+    extra += i.count() - 1;
+  }
+
+  Val i = cast<size_t>(l - first - extra);
+  return { p + i, cast<uint>(l), b, i };
+}
+
+bool Paragraphs::stale(size_t p)const
+{
+  Val at = find_paragraph(p);
+  Val block = m_blocks[at.first];
+  return block.epoch != m_epoch || !block.current[at.second];
+}
+
+Paragraphs::Para const* Paragraphs::peek(size_t b, size_t i)const
+{
+  Val paras = m_blocks[b].paras;
+  Val found = lower(paras, i);
+  return found != paras.cend() && found->index == i ? &*found : nullptr;
+}
+
+Paragraphs::Para& Paragraphs::materialize(size_t b, size_t i)
+{
+  auto &paras = m_blocks[b].paras;
+  auto found = lower(paras, i);
+  if(found == paras.end() || found->index != i)
+  {
+    found = paras.emplace(found);
+    found->index = cast<uint>(i);
+  }
+  return *found;
+}
+
+void Paragraphs::remove(size_t first, size_t n)
+{
+  while(n)
+  {
+    Val at = find_paragraph(first);
+    auto &block = m_blocks[at.first];
+
+    const size_t k = std::min(n, block.count - at.second);
+    Val begin = lower(block.paras, at.second)
+        , end = lower(block.paras, at.second + k);
+    uint64 lines = k;
+    for(auto i=begin; i!=end; ++i)
+      lines += i->count() - 1;
+
+    for(auto i=block.paras.erase(begin, end); i!=block.paras.end(); ++i)
+      i->index -= cast<uint>(k);
+
+    if(block.epoch == m_epoch)
+    {
+      Val from = block.current.begin() + cast<ptrdiff_t>(at.second)
+          , to = from + cast<ptrdiff_t>(k);
+      m_stale -= cast<size_t>(std::count(from, to, false));
+      block.current.erase(from, to);
+    }
+    else
+      m_stale -= k;
+
+    block.count -= k;
+    block.lines -= lines;
+    m_paragraphs -= k;
+    m_lines -= lines;
+    n -= k;
+
+    if(block.count)
+    {
+      m_block_paras.add(at.first, -cast<int64>(k));
+      m_block_lines.add(at.first, -cast<int64>(lines));
+    }
+    else
+    {
+      m_blocks.erase(m_blocks.cbegin() + cast<ptrdiff_t>(at.first));
+      reindex();
+    }
+  }
+}
+
+void Paragraphs::insert(size_t first, size_t n)
+{
+  if(m_blocks.empty())
+  {
+    m_blocks.push_back(Block{ 0, 0, 0, {}, {} });
+    reindex();
+  }
+
+  Val at = find_paragraph(first);
+  auto &block = m_blocks[at.first];
+
+  for(auto i=lower(block.paras, at.second); i!=block.paras.end(); ++i)
+    i->index += cast<uint>(n);
+  if(block.epoch == m_epoch)
+    block.current.insert(block.current.begin() + cast<ptrdiff_t>(at.second), n, false);
+
+  block.count += n;
+  block.lines += n;
+  m_paragraphs += n;
+  m_lines += n;
+  m_stale += n;
+
+  if(block.count <= block_size * 2)
+  {
+    m_block_paras.add(at.first, cast<int64>(n));
+    m_block_lines.add(at.first, cast<int64>(n));
+    return;
+  }
+
+  vector<Block> split;
+  auto para = block.paras.begin();
+  for(size_t i=0; i<block.count; i+=block_size)
+  {
+    const size_t e = std::min(block.count, i + size_t(block_size));
+    split.emplace_back(Block{ e - i, e - i, block.epoch, {}, {} });
+    auto &b = split.back();
+    if(block.epoch == m_epoch)
+      b.current.assign(block.current.begin() + cast<ptrdiff_t>(i), block.current.begin() + cast<ptrdiff_t>(e));
+
+    for(; para!=block.paras.end() && para->index<e; ++para)
+    {
+      b.lines += para->count() - 1;
+      b.paras.emplace_back(move(*para));
+      b.paras.back().index -= cast<uint>(i);
+    }
+  }
+
+  m_blocks.erase(m_blocks.cbegin() + cast<ptrdiff_t>(at.first));
+  m_blocks.insert(m_blocks.cbegin() + cast<ptrdiff_t>(at.first), make_move_iterator(split.begin()), make_move_iterator(split.end()));
+  reindex();
+}
+
+void Paragraphs::reindex()
+{
+  vector<uint64> paras, lines;
+  for(Val i: m_blocks)
+  {
+    paras.emplace_back(i.count);
+    lines.emplace_back(i.lines);
+  }
+  m_block_paras.assign(paras);
+  m_block_lines.assign(lines);
+}
+
+void Paragraphs::trim()
+{
+  for(auto &b: m_blocks)
+    b.paras.erase(std::remove_if(b.paras.begin(), b.paras.end(), [](Val p){ return p.breaks.empty(); }), b.paras.end());
+  m_cached = 0;
+}
+
+void Paragraphs::wrap(size_t p)
+{
+  Val at = find_paragraph(p);
+  auto &block = m_blocks[at.first];
+  Val old = peek(at.first, at.second);
+  Val before = old ? old->count() : 1;
+  Val stale = block.epoch != m_epoch || !block.current[at.second];
+
+  vector<uint> breaks;
+  vector<float> widths;
+  Val text = m_text.substr(m_text.line_start(p), bytes(p));
+  Val begin = text.data()
+      , end = begin + text.size();
+  auto i = begin;
+  do
+  {
+    Val fit = Text::GetSizeFor(i, end, m_font, m_scale, m_width);
+    widths.emplace_back(fit.first.x);
+    if(i == end)
+      break;
+
+    utf8::unchecked::advance(i, std::max(1u, fit.second));
+    if(i != end)
+      breaks.emplace_back(cast<uint>(i - begin));
+  }
+  while(i != end);
+
+  Val after = cast<uint>(breaks.size()) + 1;
+  if(breaks.empty())
+  {
+    if(old)
+      block.paras.erase(lower(block.paras, at.second));
+  }
+  else
+  {
+    auto &para = materialize(at.first, at.second);
+    para.breaks = move(breaks);
+    para.widths = move(widths);
+    para.advances.reset();
+    para.interned.reset();
+  }
+
+  if(block.epoch != m_epoch)
+  {
+    block.current.assign(block.count, false);
+    block.epoch = m_epoch;
+  }
+  block.current[at.second] = true;
+  if(stale)
+    --m_stale;
+
+  Val d = cast<int64>(after) - cast<int64>(before);
+  if(d)
+  {
+    block.lines = cast<uint64>(cast<int64>(block.lines) + d);
+    m_lines = cast<uint64>(cast<int64>(m_lines) + d);
+    m_block_lines.add(at.first, d);
+  }
+}
+
+size_t Paragraphs::bytes(size_t p)const
+{
+  Val end = p + 1 < m_paragraphs ? m_text.line_start(p + 1) - 1 : m_text.size();
+  return end - m_text.line_start(p);
+}
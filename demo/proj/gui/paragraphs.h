@@ -0,0 +1,93 @@
+#pragma once
+#include "objects.h"
+#include "base_classes/utility/text_buffer.h"
+
+namespace GUI
+{
+
+//'\n' separated text broken into lines no wider than max_width; an edit only re-breaks the paragraphs it touches,
+//a layout change keeps the old breaks until a paragraph is rewrapped, visible lines first.
+//paragraphs live in blocks indexed by fenwick trees over paragraph and line counts, so line lookups and edits are O(log n);
+//a block only stores the paragraphs that wrap to several lines or hold display caches, the rest are a line each
+struct Paragraphs
+{
+  Paragraphs();
+
+  void Layout(Font const*font, float scale, float max_width);
+  void Update(String text);
+  void Update(TextBuffer const&text);
+  void Edit(TextBuffer const&text, size_t at, size_t erased, size_t inserted);
+
+  void Wrap(uint first_line, uint count);
+  bool Wrap(uint budget=wrap_budget);
+
+  uint lines()const      { return cast<uint>(m_lines);      }
+  uint paragraphs()const { return cast<uint>(m_paragraphs); }
+  uint paragraph(uint line)const;
+  bool wrapped(uint line)const;
+  pair<size_t, size_t> span(uint line)const;
+  string8 text(uint line)const;
+  Interned const& interned(uint line)const;
+  float width(uint line)const;
+  Advances const& advances(uint line)const;
+
+  TextBuffer const& buffer()const { return m_text; }
+
+private:
+  enum : uint { wrap_budget = 256, block_size = 512, cache_limit = 4096 };
+
+  struct Para {
+    uint count()const { return breaks.empty() ? 1 : cast<uint>(breaks.size()) + 1; }
+
+    uint index = 0; //within the block
+    vector<uint> breaks;
+    vector<float> widths;
+    mutable unique_ptr<vector<Advances>> advances;
+    mutable unique_ptr<vector<Interned>> interned;
+  };
+
+  struct Block {
+    size_t count;
+    uint64 lines;
+    uint epoch;           //epoch the current flags belong to, older means every paragraph is stale
+    vector<bool> current; //paragraph wrapped at epoch
+    vector<Para> paras;   //sorted by index, sparse
+  };
+
+  struct Fenwick {
+    void assign(vector<uint64> const&v);
+    void add(size_t i, int64 d);
+    uint64 prefix(size_t i)const;
+    size_t find(uint64 v)const;
+
+    vector<uint64> tree;
+  };
+
+  struct Line { size_t paragraph; uint first; size_t block, index; };
+
+  pair<size_t, size_t> find_paragraph(size_t p)const;
+  Line find_line(uint line)const;
+  bool stale(size_t p)const;
+  Para const* peek(size_t b, size_t i)const;
+  Para& materialize(size_t b, size_t i);
+  void remove(size_t first, size_t n);
+  void insert(size_t first, size_t n);
+  void reindex();
+  void trim();
+  void wrap(size_t p);
+  size_t bytes(size_t p)const;
+
+  Font const*m_font = nullptr;
+  float m_scale = 0, m_width = 0;
+  TextBuffer m_text;
+  string8 m_plain; //last text given as a string, valid while m_text is at m_plain_revision
+  uint64 m_plain_revision = 0;
+  vector<Block> m_blocks;
+  Fenwick m_block_paras, m_block_lines;
+  uint64 m_lines = 1;
+  size_t m_paragraphs = 1, m_stale = 1, m_next = 0;
+  uint m_epoch = 1;
+  mutable size_t m_cached = 0; //display caches made for single line paragraphs since the last trim
+};
+
+}
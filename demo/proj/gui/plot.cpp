@@ -0,0 +1,117 @@
+#include "plot.h"
+#include <glm/common.hpp>
+#include <algorithm>
+
+using namespace GUI;
+
+PlotData::PlotData()
+  : m_levels(1)
+  , m_dirty(1, 0)
+  , m_tex(GL_RG32F)
+{ }
+
+void PlotData::Append(float const*samples, size_t n)
+{
+  auto &raw = m_levels.front();
+  m_dirty.front() = glm::min(m_dirty.front(), raw.size());
+  raw.reserve(raw.size() + n);
+  for(size_t i=0; i<n; ++i)
+    raw.emplace_back(samples[i]);
+
+  for(uint l=1; m_levels[l - 1].size() > 1 && l<max_levels; ++l)
+  {
+    if(l == m_levels.size())
+    {
+      m_levels.emplace_back();
+      m_dirty.emplace_back(0);
+    }
+
+    Val prev = m_levels[l - 1];
+    auto &curr = m_levels[l];
+    Val from = glm::min(m_dirty[l - 1] / 2, curr.size())
+        , pairs = prev.size() / 2;
+    curr.resize((prev.size() + 1) / 2);
+
+    for(size_t i=from; i<pairs; ++i)
+    {
+      Val a = prev[i * 2]
+          , b = prev[i * 2 + 1];
+      curr[i] = vec2(glm::min(a.x, b.x), glm::max(a.y, b.y));
+    }
+
+    if(prev.size() & 1)
+      curr.back() = prev.back();
+
+    m_dirty[l] = glm::min(m_dirty[l], from);
+  }
+}
+
+void PlotData::Clear()
+{
+  m_levels.assign(1, { });
+  m_dirty.assign(1, 0);
+  m_capacity = 0;
+}
+
+void PlotData::Trim(size_t keep)
+{
+  Val raw = m_levels.front();
+  if(raw.size() <= keep)
+    return;
+
+  vector<float> tail(keep);
+  std::transform(raw.cend() - cast<ptrdiff_t>(keep), raw.cend(), tail.begin(), [](vec2 const&s){ return s.x; });
+  Clear();
+  Append(tail);
+}
+
+static size_t levelSize(size_t capacity, uint l)
+{
+  return glm::max<size_t>(1, (capacity + (size_t(1) << l) - 1) >> l);
+}
+
+vector<int> PlotData::offsets()const
+{
+  vector<int> o(m_levels.size());
+  size_t at = 0;
+  for(uint l=0; l<m_levels.size(); ++l)
+  {
+    o[l] = cast<int>(at);
+    at += levelSize(m_capacity, l);
+  }
+
+  return o;
+}
+
+GLtexBuffer const& PlotData::Upload()const
+{
+  auto &dirty = m_dirty;
+  auto b = GLbind(m_tex.buffer());
+
+  if(size() > m_capacity)
+  {
+    m_capacity = glm::max<size_t>(1024, m_capacity);
+    while(m_capacity < size())
+      m_capacity *= 2;
+
+    size_t total = 0;
+    for(uint l=0; l<max_levels; ++l)
+      total += levelSize(m_capacity, l);
+
+    b.AllocateBuffer(nullptr, total * sizeof(vec2), GL_DYNAMIC_DRAW);
+    std::fill(dirty.begin(), dirty.end(), 0);
+  }
+
+  Val o = offsets();
+  for(uint l=0; l<m_levels.size(); ++l)
+  {
+    Val level = m_levels[l];
+    Val from = dirty[l];
+    if(from < level.size())
+      b.UpdateBuffer(level.data() + from, (level.size() - from) * sizeof(vec2), (cast<size_t>(o[l]) + from) * sizeof(vec2));
+
+    dirty[l] = level.size();
+  }
+
+  return m_tex;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "base_classes/gl/texture.h"
+
+namespace GUI
+{
+
+struct PlotData
+{
+  struct View { double first = 0, count = 0; float min = -1, max = 1; };
+
+  PlotData();
+
+  void Append(float const*samples, size_t n);
+  void Append(vector<float> const&samples) { Append(samples.data(), samples.size()); }
+  void Clear();
+  void Trim(size_t keep); //drops all but the last keep samples
+
+  uint size()const   { return cast<uint>(m_levels.front().size()); }
+  uint levels()const { return cast<uint>(m_levels.size());         }
+  vector<int> offsets()const;
+
+  GLtexBuffer const& Upload()const;
+
+  View view;
+  static constexpr uint max_levels = 32;
+
+private:
+  vector<vector<vec2>> m_levels;
+  mutable vector<size_t> m_dirty;
+  mutable GLtexBuffer m_tex;
+  mutable size_t m_capacity = 0;
+};
+
+}
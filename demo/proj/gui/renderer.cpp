@@ -1,5 +1,6 @@
 #include "renderer.h"
 #include "base_classes/policies/window.h"
+#include "base_classes/glyph_cache.h"
 #include <glm/gtc/epsilon.hpp>
 #include <GLFW/glfw3.h>
 #include <numeric>
@@ -32,8 +33,14 @@ struct Renderer::Batch {
     return *objs[indices.front()].obj;
   }
 
+  bool joinable(Objs objs, Obj const&o, uint z)const {
+    return front(objs).check_batchable(o) &&
+        ClipTable::page(front(objs).clip()) == ClipTable::page(o.clip()) &&
+        SlotTable::page(indices.front()) == SlotTable::page(z);
+  }
+
   bool contains(Objs objs, Obj const&o, uint z)const {
-    return front(objs).check_batchable(o) && std::binary_search(indices.cbegin(), indices.cend(), z);
+    return joinable(objs, o, z) && std::binary_search(indices.cbegin(), indices.cend(), z);
   }
 
   bool covered(Objs objs, Obj const&o)const {
@@ -43,7 +50,7 @@ struct Renderer::Batch {
 
   bool covered(Objs objs, Obj const&o, uint z)const {
     if(!front(objs).ordered() ||
-       front(objs).check_batchable(o))
+       joinable(objs, o, z))
       return false;
 
     Val begin = std::find_if(indices.crbegin(), indices.crend(), [&](uint i){ return i < z; }).base();
@@ -52,7 +59,7 @@ struct Renderer::Batch {
 
   bool covers(Objs objs, Obj const&o, uint z)const {
     if(!front(objs).ordered() ||
-       front(objs).check_batchable(o))
+       joinable(objs, o, z))
       return false;
 
     Val end = std::find_if(indices.cbegin(), indices.cend(), [&](uint i){ return i > z; });
@@ -60,7 +67,7 @@ struct Renderer::Batch {
   }
 
   bool try_to_add(Objs objs, Obj const&o, uint z) {
-    if(!front(objs).check_batchable(o))
+    if(!joinable(objs, o, z))
       return false;
 
     indices.emplace_back(z);
@@ -73,7 +80,7 @@ struct Renderer::Batch {
     return indices.empty();
   }
 
-  auto redraw(vector<Object> &objs, uint first_invalid_index) {
+  auto redraw(vector<Object> &objs, uint first_invalid_index, bool color_table, uint &regenerated) {
     Val expand = [](auto &v, uint b, uint s){ v.insert(v.cbegin() + b, s, 0);          };
     Val erase =  [](auto &v, uint s, uint e){ v.erase(v.cbegin() + s, v.cbegin() + e); };
 
@@ -99,6 +106,7 @@ struct Renderer::Batch {
         xyzw.resize(to * 4);
         rgba.resize(to * 4);
         uv.resize(to * 2);
+        slot.resize(to);
         state = State::full;
       }
       else
@@ -112,6 +120,7 @@ struct Renderer::Batch {
           expand(xyzw, at * 4, s * 4);
           expand(rgba, at * 4, s * 4);
           expand(uv,   at * 2, s * 2);
+          expand(slot, at,     s);
           state = State::full;
         }
 
@@ -122,13 +131,26 @@ struct Renderer::Batch {
           erase(xyzw, from * 4, to * 4);
           erase(rgba, from * 4, to * 4);
           erase(uv,   from * 2, to * 2);
+          erase(slot, from,     to);
           state = State::full;
         }
       }
 
       flush |= state;
       o.genMesh(1. - double(i) / 1000, state, xyzw.begin() + start * 4, rgba.begin() + start * 4, uv.begin() + start * 2);
+
+      if(color_table || obj.tweened)
+      {
+        Val flags = cast<GLushort>((color_table ? uint(ColorTable::flag) : 0u) | (obj.tweened ? uint(TweenTable::flag) : 0u));
+        if(state & State::xyzw)
+          for(uint v=start; v<start + size; ++v)
+          {
+            xyzw[v * 4 + 3] |= flags;
+            slot[v] = cast<GLushort>(SlotTable::slot(i));
+          }
+      }
       obj.last_size = size;
+      regenerated += size;
 
       start += size;
     }
@@ -138,6 +160,7 @@ struct Renderer::Batch {
       xyzw.resize(start * 4);
       rgba.resize(start * 4);
       uv.resize(start * 2);
+      slot.resize(start);
 
       flush = State::full;
     }
@@ -147,7 +170,7 @@ struct Renderer::Batch {
 
   uint idx_start = 0, idx_size = 0;
   vector<uint> indices;
-  vector<GLushort> xyzw, uv;
+  vector<GLushort> xyzw, uv, slot;
   vector<GLubyte> rgba;
 };
 
@@ -156,9 +179,12 @@ Renderer::Renderer()
 {
   auto b = GLbind(m_vao);
   GLbind(m_idx.vbo);
-  b.AttribFormat(m_xyzw.vbo, 0, 4, GL_HALF_FLOAT);
+  b.AttribFormat(m_xyzw.vbo, 0, 3, GL_HALF_FLOAT, GL_FALSE, 4 * sizeof(GLushort));
+  b.AttribIFormat(m_xyzw.vbo, 3, 1, GL_UNSIGNED_SHORT, 4 * sizeof(GLushort), reinterpret_cast<void*>(3 * sizeof(GLushort)));
   b.AttribFormat(m_rgba.vbo, 1, 4, GL_UNSIGNED_BYTE, GL_TRUE);
   b.AttribFormat(m_uv.vbo,   2, 2, GL_HALF_FLOAT);
+
+  GLbind(m_time_ubo).AllocateBuffer(nullptr, sizeof(vec4), GL_DYNAMIC_DRAW);
 }
 
 Renderer::~Renderer()
@@ -168,7 +194,7 @@ bool Renderer::hovered()
 {
   CASSERT(m_num > 0, "No object, can't check hover");
 
-  return contains(m_objects[m_num - 1].obj->bounding_box(), this->mouse_pos());
+  return contains(clipped(*m_objects[m_num - 1].obj), this->mouse_pos());
 }
 
 bool Renderer::hovered(Vec4 bb)
@@ -246,7 +272,7 @@ vector<Event> Renderer::ProcessEvents()
 void Renderer::Logic(function<bool(Event const&)> func, ObjectId id)
 {
   CASSERT(m_num > 0, "No object, can't check focus");
-  Val bb = m_objects[m_num - 1].obj->bounding_box();
+  Val bb = clipped(*m_objects[m_num - 1].obj);
   Logic(bb, move(func), id);
 }
 
@@ -261,13 +287,125 @@ void Renderer::Logic(Vec4 bb, function<bool(Event const&)> func, ObjectId id)
 
 void Renderer::Clip(Vec2 pos, Vec2 size) {
   const vec2 is_neg = glm::lessThan(size, vec2(0));
-  m_clip = { pos + size * is_neg, pos + glm::abs(size) };
+  Val clip = vec4(pos + size * is_neg, pos + glm::abs(size));
+
+  if(clip == m_clips[m_clip])
+    return;
+
+  Val found = m_clip_index.emplace(clip, cast<uint>(m_clips.size()));
+  m_clip = found.first->second;
+  if(found.second)
+    m_clips.emplace_back(clip);
+}
+
+size_t Renderer::ClipHash::operator()(Vec4 c)const
+{
+  Val h = std::hash<float>();
+  return h(c.x) ^ (h(c.y) << 1) ^ (h(c.z) << 2) ^ (h(c.w) << 3);
+}
+
+void Renderer::Animate(Tween const&t)
+{
+  CASSERT(m_num > 0, "No object to animate");
+
+  Val slot = m_num - 1;
+  auto &o = m_objects[slot];
+  o.tweened = true;
+
+  if(o.was_tweened &&
+     o.tween == t &&
+     !(o.state & State::xyzw))
+    return;
+
+  o.tween = t;
+  setTween(slot);
+}
+
+void Renderer::setTween(uint slot)
+{
+  Val o = m_objects[slot];
+  Val t = o.tween;
+  Val aspect = Window::Get().aspect();
+  Val bb = o.obj->bounding_box();
+  Val pivot = (vec2(bb.x, bb.y) + vec2(bb.z, bb.w)) / 2.f * aspect;
+  Val v = array<vec4, TweenTable::stride>{{ t.color_from, t.color_to,
+                                            vec4(t.offset_from * aspect, t.offset_to * aspect),
+                                            vec4(t.scale_from, t.scale_to, pivot),
+                                            vec4(t.start - m_time_base, t.duration, float(t.ease), t.colored ? 1 : 0) }};
+  m_tweens.set(slot, v.data());
+}
+
+void Renderer::setColor(uint slot)
+{
+  Val c = glm::uvec4(glm::round(glm::clamp(m_objects[slot].obj->color(), vec4(0), vec4(1)) * 255.f));
+  Val packed = c.r | c.g << 8 | c.b << 16 | c.a << 24;
+  m_colors.set(slot, &packed);
+}
+
+vec4 Renderer::clipped(Obj const&o)const
+{
+  Val bb = o.bounding_box()
+      , clip = m_clips[o.clip()];
+  Val crop1 = vec2(clip.x, clip.y)
+      , crop2 = vec2(clip.z, clip.w);
+
+  return { glm::clamp(vec2(bb.x, bb.y), crop1, crop2), glm::clamp(vec2(bb.z, bb.w), crop1, crop2) };
 }
 
 void Renderer::Render()
 {
+  GlyphCache::Get().Update();
+
+  m_stats.objects = m_num;
+  m_stats.first_invalid = m_num;
+
+  bool tweened = false;
+  for(uint i=0; i<m_num; ++i)
+  {
+    auto &o = m_objects[i];
+    tweened |= o.tweened;
+    if(o.tweened != o.was_tweened)
+    {
+      o.state |= State::xyzw | State::rgba;
+      m_flush |= State::xyzw | State::rgba;
+    }
+  }
+
+  if(color_table != m_color_table)
+  {
+    m_color_table = color_table;
+    if(color_table)
+      for(uint i=0; i<m_num; ++i)
+        setColor(i);
+
+    //colours come from the table in that mode, so the rgba stream is neither bound nor uploaded
+    auto b = GLbind(m_vao);
+    if(color_table)
+      b.AttribDisable(1);
+    else
+      b.AttribFormat(m_rgba.vbo, 1, 4, GL_UNSIGNED_BYTE, GL_TRUE);
+
+    if(m_num)
+      m_objects.front().state = State::mismatch;
+    m_flush = State::full;
+  }
+
+  //the slot stream is only read for table colours and tweens, without those it's neither bound nor uploaded
+  Val slots = m_color_table || tweened
+      , refill_slots = slots && !m_slots;
+  if(slots != m_slots)
+  {
+    m_slots = slots;
+    auto b = GLbind(m_vao);
+    if(slots)
+      b.AttribIFormat(m_slot.vbo, 4, 1, GL_UNSIGNED_SHORT);
+    else
+      b.AttribDisable(4);
+  }
+
   if(m_flush)
   {
+    Val batching_start = timing ? clock::now() : clock::time_point{ };
     Val get_index = [&](Val i){ return cast<uint>(std::distance(m_objects.cbegin(), i)); };
 
     Val last_valid = m_objects.cbegin() + m_num
@@ -294,6 +432,7 @@ void Renderer::Render()
       return last_valid;
     }();
     Val first_invalid_index = get_index(first_invalid);
+    m_stats.first_invalid = first_invalid_index;
 
     if(first_invalid != m_objects.cend())
     {
@@ -320,6 +459,9 @@ void Renderer::Render()
         m_batches.emplace(m_batches.cbegin(), Batch{ z });
     }();
 
+    if(timing)
+      m_stats.time_batching += seconds(batching_start);
+
     m_flush = 0;
     uint index_start = 0, batch_start = 0;
     Val insert = [](bool ordered, uint dim, auto &to, size_t at, Val v) {
@@ -333,10 +475,15 @@ void Renderer::Render()
 
     for(auto &i: m_batches)
     {
-      Val batch = i.redraw(m_objects, first_invalid_index);
+      Val mesh_start = timing ? clock::now() : clock::time_point{ };
+      Val batch = i.redraw(m_objects, first_invalid_index, m_color_table, m_stats.vertices_regenerated);
       Val batch_size = batch.first;
       m_flush |= batch.second;
 
+      if(timing)
+        m_stats.time_mesh += seconds(mesh_start);
+      Val upload_start = timing ? clock::now() : clock::time_point{ };
+
       if(m_flush & State::resized)
       {
         Val indices = i.front(m_objects).genIdx(batch_start, batch_size);
@@ -346,44 +493,132 @@ void Renderer::Render()
       }
       Val ordered = i.front(m_objects).ordered();
       if(m_flush & State::xyzw) insert(ordered, 4, m_xyzw.buff, batch_start, i.xyzw);
-      if(m_flush & State::rgba) insert(ordered, 4, m_rgba.buff, batch_start, i.rgba);
+      if(m_slots &&
+         (m_flush & State::xyzw ||
+          refill_slots))        insert(ordered, 1, m_slot.buff, batch_start, i.slot);
+      if(m_flush & State::rgba &&
+         !m_color_table)        insert(ordered, 4, m_rgba.buff, batch_start, i.rgba);
       if(m_flush & State::uv)   insert(ordered, 2, m_uv.buff,   batch_start, i.uv);
 
       index_start += i.idx_size;
       batch_start += batch_size;
+
+      if(timing)
+        m_stats.time_upload += seconds(upload_start);
     }
   }
 
+  Val upload_start = timing ? clock::now() : clock::time_point{ };
   Val b = GLbind(m_vao);
-  if(m_flush & State::resized) m_idx.flush();
-  if(m_flush & State::xyzw)    m_xyzw.flush();
-  if(m_flush & State::rgba)    m_rgba.flush();
-  if(m_flush & State::uv)      m_uv.flush();
+  if(m_flush & State::resized) m_stats.bytes_idx = m_idx.flush();
+  if(m_flush & State::xyzw)    m_stats.bytes_xyzw = m_xyzw.flush();
+  if(m_slots &&
+     (m_flush & State::xyzw ||
+      refill_slots))           m_stats.bytes_slot = m_slot.flush();
+  if(m_flush & State::rgba &&
+     !m_color_table)           m_stats.bytes_rgba = m_rgba.flush();
+  if(m_flush & State::uv)      m_stats.bytes_uv = m_uv.flush();
+  if(m_color_table)            m_stats.bytes_colors = m_colors.flush();
+
+  //past ~17 minutes a float time would get coarse enough to make tweens step, so the base moves up and live tweens are rewritten against it
+  Val elapsed = time();
+  if(elapsed - m_time_base > 1024)
+  {
+    m_time_base = elapsed;
+    for(uint i=0; i<m_num; ++i)
+      if(m_objects[i].tweened)
+        setTween(i);
+  }
+  m_stats.bytes_tweens = m_tweens.flush();
+
+  Val now = vec4(elapsed - m_time_base, 0, 0, 0);
+  GLbind(m_time_ubo).UpdateBuffer(&now, sizeof(vec4), 0);
+
+  Val aspect = vec4(Window::Get().aspect(), Window::Get().aspect());
+  vector<vec4> clips(m_clips.size());
+  std::transform(m_clips.cbegin(), m_clips.cend(), clips.begin(), [&](Vec4 c){ return c * aspect; });
+  if(clips != m_uploaded_clips)
+  {
+    auto b = GLbind(m_clip_ubo);
+    Val pages = ClipTable::page(cast<uint>(clips.size()) - 1) + 1;
+    if(pages > m_clip_capacity)
+    {
+      m_clip_capacity = pages;
+      b.AllocateBuffer(nullptr, pages * ClipTable::size * sizeof(vec4), GL_DYNAMIC_DRAW);
+    }
+    b.UpdateBuffer(clips.data(), clips.size() * sizeof(vec4), 0);
+    m_uploaded_clips = move(clips);
+  }
+  if(timing)
+    m_stats.time_upload += seconds(upload_start);
+
+  if(gpu_timing)
+    m_gpu_timer.Begin();
 
   GLState::Clear(GL_DEPTH_BUFFER_BIT);
 
   GLState::BlendFunc::Save();
   GLState::DepthFunc::Save();
-  GLState::Save<GL_CULL_FACE, GL_DEPTH_WRITEMASK, GL_BLEND, GL_DEPTH_TEST>();
+  GLState::Save<GL_CULL_FACE, GL_DEPTH_WRITEMASK, GL_BLEND, GL_DEPTH_TEST, GL_CLIP_DISTANCE0, GL_CLIP_DISTANCE1, GL_CLIP_DISTANCE2, GL_CLIP_DISTANCE3>();
   GLState::Disable<GL_CULL_FACE>();
-  GLState::Enable<GL_DEPTH_TEST, GL_DEPTH_WRITEMASK>();
+  GLState::Enable<GL_DEPTH_TEST, GL_DEPTH_WRITEMASK, GL_CLIP_DISTANCE0, GL_CLIP_DISTANCE1, GL_CLIP_DISTANCE2, GL_CLIP_DISTANCE3>();
+  GLCHECK(glBindBufferBase(GL_UNIFORM_BUFFER, TweenTable::binding, m_time_ubo.obj()));
+  if(m_color_table)
+    GLbind(m_colors.tex, ColorTable::unit);
+  if(!m_tweens.buff.empty())
+    GLbind(m_tweens.tex, TweenTable::unit);
   GLState::BlendFunc::Set(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   GLState::DepthFunc::Set(GL_LEQUAL);
 
   Val first_ordered = std::find_if(m_batches.cbegin(), m_batches.cend(), [&](Val i){ return i.front(m_objects).ordered(); });
+  uint bound_page = ~0u, slot_page = 0;
+  Val draw = [&](Val i){
+    Val page = ClipTable::page(i.front(m_objects).clip());
+    if(page != bound_page)
+    {
+      bound_page = page;
+      Val table = ClipTable::size * sizeof(vec4);
+      GLCHECK(glBindBufferRange(GL_UNIFORM_BUFFER, ClipTable::binding, m_clip_ubo.obj(), cast<GLintptr>(page * table), cast<GLsizeiptr>(table)));
+    }
+
+    Val table_page = SlotTable::page(i.indices.front());
+    if(table_page != slot_page)
+    {
+      slot_page = table_page;
+      Val frame = vec4(now.x, table_page * SlotTable::size, 0, 0);
+      GLbind(m_time_ubo).UpdateBuffer(&frame, sizeof(vec4), 0);
+    }
+
+    Val shader = StateControl<ShaderProgramPolicy>::m_bound_object;
+    StateControl<VaoPolicy>::Bind(m_vao.obj());
+    i.front(m_objects).Draw(b, cast<GLushort>(i.idx_size), cast<GLushort>(i.idx_start));
+    m_stats.shader_switches += shader != StateControl<ShaderProgramPolicy>::m_bound_object;
+    ++m_stats.draw_calls;
+  };
 
   GLState::Disable<GL_BLEND>();
-  std::for_each(m_batches.cbegin(), first_ordered, [&](Val i){ i.front(m_objects).Draw(b, cast<GLushort>(i.idx_size), cast<GLushort>(i.idx_start)); });
+  std::for_each(m_batches.cbegin(), first_ordered, draw);
 
   GLState::Enable<GL_BLEND>();
-  std::for_each(first_ordered, m_batches.cend(), [&](Val i){ i.front(m_objects).Draw(b, cast<GLushort>(i.idx_size), cast<GLushort>(i.idx_start)); });
+  std::for_each(first_ordered, m_batches.cend(), draw);
 
-  GLState::Restore<GL_CULL_FACE, GL_DEPTH_WRITEMASK, GL_BLEND, GL_DEPTH_TEST>();
+  GLState::Restore<GL_CULL_FACE, GL_DEPTH_WRITEMASK, GL_BLEND, GL_DEPTH_TEST, GL_CLIP_DISTANCE0, GL_CLIP_DISTANCE1, GL_CLIP_DISTANCE2, GL_CLIP_DISTANCE3>();
   GLState::DepthFunc::Restore();
   GLState::BlendFunc::Restore();
 
+  if(gpu_timing)
+    m_stats.time_gpu = m_gpu_timer.End();
+
+  m_stats.batches = cast<uint>(m_batches.size());
+  m_last_stats = m_stats;
+  m_stats = Stats{ };
+
   m_num = 0;
   m_flush = 0;
+  m_clip = 0;
+  m_clips.resize(1);
+  m_clip_index.clear();
+  m_clip_index.emplace(m_clips.front(), 0);
 
   Val window = Window::Get();
   if(!window.equalPos(m_aspect, window.aspect()))
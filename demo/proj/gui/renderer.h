@@ -1,6 +1,8 @@
 #pragma once
 #include "objects.h"
 #include "base_classes/gl/objects.h"
+#include "base_classes/gl/texture.h"
+#include "base_classes/policies/profiling.h"
 
 namespace code_policy { struct Event; }
 
@@ -11,30 +13,56 @@ struct Renderer
 {
   typedef void const* ObjectId;
 
+  struct Stats {
+    uint objects = 0, unchanged = 0, changed = 0, mismatched = 0, first_invalid = 0
+        , batches = 0, draw_calls = 0, shader_switches = 0, vertices_regenerated = 0;
+    uint64 bytes_idx = 0, bytes_xyzw = 0, bytes_rgba = 0, bytes_uv = 0, bytes_slot = 0, bytes_colors = 0, bytes_tweens = 0;
+    double time_compare = 0, time_batching = 0, time_mesh = 0, time_upload = 0, time_gpu = 0;
+  };
+
   Renderer();
   ~Renderer();
 
   template<class T, class...P> void Draw(P ...p) {
     if(m_num < m_objects.size())
     {
+      Val start = timing ? clock::now() : clock::time_point{ };
       auto &curr = m_objects[m_num];
-      Val state = curr.obj->compare(m_clip, p...);
+      //moving to another clip table page means moving to another batch
+      Val changed = curr.obj->compare(m_clip, p...)
+          | (ClipTable::page(curr.obj->clip()) == ClipTable::page(m_clip) ? 0u : State::mismatch);
+      Val state = (color_table || (curr.tweened && curr.tween.colored)) && changed == State::rgba ? 0u : changed;
+      curr.was_tweened = curr.tweened;
+      curr.tweened = false;
       m_flush |= state;
 
-      if(state)
+      if(changed)
+      {
         curr.obj = make_unique<T>(T::Make(m_clip, move(p)...));
+        if(color_table)
+          setColor(m_num);
+      }
 
       curr.state = state;
+
+      ++(!changed ? m_stats.unchanged : changed & State::mismatch ? m_stats.mismatched : m_stats.changed);
+      if(timing)
+        m_stats.time_compare += seconds(start);
     }
     else
     {
       m_flush = State::full;
-      m_objects.emplace_back(Object{ make_unique<T>(T::Make(m_clip, move(p)...)), State::mismatch, 0 });
+      m_objects.emplace_back(Object{ make_unique<T>(T::Make(m_clip, move(p)...)), State::mismatch, 0, false, false, { } });
+      if(color_table)
+        setColor(m_num);
+      ++m_stats.mismatched;
     }
 
     ++m_num;
   }
 
+  Val stats()const { return m_last_stats; }
+
   Val mouse_pos()const { return m_mouse_pos; }
   bool hovered();
   bool hovered(Vec4 bb);
@@ -46,13 +74,32 @@ struct Renderer
 
   void Clip(Vec2 pos, Vec2 size);
 
+  //seconds since the renderer was made. the gpu gets it, and tween starts, as floats relative to a base that moves up every few minutes
+  double time()const { return seconds(m_epoch); }
+  void Animate(Tween const&t);
+
   void Render();
 
   ObjectId focused_id = 0;
+  bool timing = false, gpu_timing = false, color_table = false;
 private:
+  using clock = std::chrono::steady_clock;
+  static double seconds(clock::time_point start) { return std::chrono::duration<double>(clock::now() - start).count(); }
+  vec4 clipped(Obj const&o)const;
+  void setColor(uint slot);
+  void setTween(uint slot);
+
   uint m_num = 0, m_flush = 0;
   vec2 m_mouse_pos = vec2(0), m_aspect = vec2(1);
-  vec4 m_clip = vec4(-1, -1, 2, 2);
+  struct ClipHash { size_t operator()(Vec4 c)const; };
+  uint m_clip = 0, m_clip_capacity = 0;
+  vector<vec4> m_clips = { vec4(-1, -1, 2, 2) }, m_uploaded_clips;
+  unordered_map<vec4, uint, ClipHash> m_clip_index = { { vec4(-1, -1, 2, 2), 0 } };
+  GLbuffer<GL_UNIFORM_BUFFER> m_clip_ubo;
+  bool m_color_table = false, m_slots = false;
+  clock::time_point m_epoch = clock::now();
+  double m_time_base = 0;
+  GLbuffer<GL_UNIFORM_BUFFER> m_time_ubo;
   GLvao m_vao;
   vector<vec2> m_interactions;
   vector<Event> m_events;
@@ -60,13 +107,17 @@ private:
   struct LogicStorage;
   vector<LogicStorage> m_logics;
 
+  Stats m_stats, m_last_stats;
+  GLQuery m_gpu_timer;
+
   template<GLenum m_type, class T>
   struct BufferStorage {
-    void flush() {
+    uint64 flush() {
       auto b = GLbind(vbo);
       b.AllocateBuffer(0, last_size);
       b.AllocateBuffer(buff);
       last_size = buff.size();
+      return buff.size() * sizeof(T);
     }
 
     GLbuffer<m_type> vbo;
@@ -74,12 +125,62 @@ private:
     vector<T> buff;
   };
   BufferStorage<GL_ELEMENT_ARRAY_BUFFER, GLushort> m_idx;
-  BufferStorage<GL_ARRAY_BUFFER, GLushort> m_xyzw, m_uv;
+  BufferStorage<GL_ARRAY_BUFFER, GLushort> m_xyzw, m_uv, m_slot;
   BufferStorage<GL_ARRAY_BUFFER, GLubyte> m_rgba;
 
+  template<class T, uint m_stride>
+  struct TableStorage {
+    TableStorage(GLenum PRECISION)
+      : tex(PRECISION)
+    { }
+
+    void set(uint slot, T const*v) {
+      Val b = slot * m_stride
+          , e = b + m_stride;
+      if(buff.size() < e)
+        buff.resize(e);
+      std::copy(v, v + m_stride, buff.begin() + b);
+
+      from = from == to ? b : std::min(from, b);
+      to = from == b && to <= b ? e : std::max(to, e);
+    }
+
+    uint64 flush() {
+      auto b = GLbind(tex.buffer());
+      Val size = cast<uint>(buff.size());
+      if(size > capacity)
+      {
+        capacity = std::max(256u * m_stride, capacity);
+        while(capacity < size)
+          capacity *= 2;
+
+        b.AllocateBuffer(nullptr, capacity * sizeof(T), GL_DYNAMIC_DRAW);
+        from = 0;
+        to = size;
+      }
+
+      Val f = from
+          , t = std::min(to, size);
+      from = to = 0;
+      if(f >= t)
+        return 0;
+
+      b.UpdateBuffer(buff.data() + f, (t - f) * sizeof(T), f * sizeof(T));
+      return (t - f) * sizeof(T);
+    }
+
+    GLtexBuffer tex;
+    uint from = 0, to = 0, capacity = 0;
+    vector<T> buff;
+  };
+  TableStorage<uint, 1> m_colors = { GL_RGBA8 };
+  TableStorage<vec4, TweenTable::stride> m_tweens = { GL_RGBA32F };
+
   struct Object {
     unique_ptr<Obj> obj;
     uint state, last_size;
+    bool tweened, was_tweened;
+    Tween tween;
   };
   vector<Object> m_objects;
 
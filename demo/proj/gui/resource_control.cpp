@@ -1,8 +1,10 @@
 #include "resource_control.h"
 #include "base_classes/policies/resource.h"
 #include "base_classes/policies/serialization.h"
+#include <limits>
 #include <numeric>
 #include <regex>
+#include <sstream>
 
 using namespace GUI;
 using std::regex;
@@ -44,49 +46,196 @@ void TextureManager::LoadRegisteredTextures(uint channels)
 }
 
 
-const Font *FontManager::Register(pair<string, string> font_description)
+const Font *FontManager::Register(pair<string, string> font_description, bool msdf)
 {
   CASSERT(!font_description.second.empty(), "No character set specified");
   Val p = m_font_objects.emplace(font_description.first, Font{ });
   CASSERT(p.second, "Don't register the same font twice");
+  if(msdf)
+    m_msdf_fonts.emplace(font_description.first);
   m_font_descriptions.emplace(move(font_description));
   return &p.first->second;
 }
 
-void FontManager::LoadRegisteredFonts(bool cache)
+namespace
+{
+enum : uint { c_cache_magic = 0x43464c47, c_cache_version = 3, c_no_atlas = ~0u }; //"GLFC"
+enum : uint { c_glyph_size = 28, c_border_size = 2, c_supersample_mult = 16, c_msdf_glyph_size = 20 };
+}
+
+static uint64 fnv1a(char const*data, size_t size, uint64 h=14695981039346656037ull)
+{
+  for(size_t i=0; i<size; ++i)
+    h = (h ^ ubyte(data[i])) * 1099511628211ull;
+  return h;
+}
+
+template<class T> static uint64 fnv1a(T const&v, uint64 h) { return fnv1a(reinterpret_cast<char const*>(&v), sizeof(T), h); }
+
+static GLenum format(uint channels) { return channels == 3 ? GL_RGB : GL_RED; }
+
+bool FontManager::loadCache(string const&filename, uint64 hash)
 {
-  static const char c_m[] = "resources/fonts_cache_map.bin", c_t[] = "resources/font_cache_atlas.png";
-  Val glyph_size = 28u, border_size = 2u, supersample_mult = 16u;
+  Val file = Resource::Map(filename);
+  if(file.empty())
+    return false;
 
-  Val signature = std::hash<string>{}(std::to_string(glyph_size) + "_" + std::to_string(border_size) + "_" + std::to_string(supersample_mult) + "_" + std::accumulate(m_font_descriptions.cbegin(), m_font_descriptions.cend(), string{}, [](string v, Val d){ return v += d.first + d.second; }));
+  FlatInputArchive a(file.data(), file.size());
+  uint magic = 0, version = 0, fonts = 0, atlases = 0;
+  uint64 file_hash = 0;
+  a(magic, version, file_hash, fonts, atlases);
+  if(!a.good() ||
+     magic != c_cache_magic ||
+     version != c_cache_version ||
+     file_hash != hash ||
+     fonts != m_font_objects.size())
+    return false;
 
-  if(cache)
+  unordered_map<string, pair<uint, Font>> loaded;
+  for(uint i=0; i<fonts; ++i)
   {
-    vector<char> atl_data(Resource::Load(c_m))
-        , tex_data(Resource::Load(c_t));
-    if(atl_data.size() > sizeof(signature) &&
-       signature == reinterpret_cast<size_t const*>(atl_data.data())[0] &&
-       !tex_data.empty())
-    {
-      atl_data.erase(atl_data.cbegin(), atl_data.cbegin() + sizeof(size_t));
-      unordered_map<string, Font> fonts_data;
-      code_policy::deserialize_from_vec(atl_data, fonts_data);
-      Val atl_tex = make_shared<GLtex2d>(ImageCodec::Decode<ubyte>(tex_data, 1), 1);
+    string name;
+    uint atlas = 0;
+    a(name, atlas);
+    if(!a.good() ||
+       (atlas >= atlases && atlas != c_no_atlas))
+      return false;
+
+    auto &f = loaded[name];
+    f.first = atlas;
+    f.second.serialize(a);
+    f.second.indexKerning();
+  }
 
-      for(auto &i: m_font_objects)
-      {
-        Val found = fonts_data.find(i.first);
-        CASSERT(found != fonts_data.cend(), "Broken font atlas");
+  vector<shared_ptr<GLtex2d>> textures;
+  for(uint i=0; i<atlases; ++i)
+  {
+    uint width = 0, height = 0, channels = 0, compressed = 0;
+    uint64 atlas_size = 0;
+    a(width, height, channels, compressed, atlas_size);
+    Val expected = uint64(width) * height * channels;
+    if(!a.good() ||
+       !width || !height ||
+       (channels != 1 && channels != 3) ||
+       expected > std::numeric_limits<uint>::max() ||
+       atlas_size > file.size() ||
+       (!compressed && atlas_size != expected))
+      return false;
 
-        i.second = found->second;
-        i.second.m_tex = atl_tex;
-      }
+    Val pixels = a.take(cast<size_t>(atlas_size));
+    if(!pixels ||
+       !a.good())
+      return false;
 
-      return;
-    }
+    vector<char> raw;
+    if(compressed &&
+       (!Compression::TryExtract({ cast<uint>(expected), vector<char>(pixels, pixels + atlas_size) }, raw) ||
+        raw.size() != expected))
+      return false;
+
+    Val tex = make_shared<GLtex2d>(width, height, channels, GL_BYTE, compressed ? raw.data() : pixels, format(channels), GL_UNSIGNED_BYTE, 1);
+    GLbind(*tex).Parameters(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    textures.emplace_back(tex);
   }
 
-  unordered_map<string, Font> font_objects = MakeFonts(m_font_descriptions, glyph_size, border_size, supersample_mult);
+  for(auto &i: m_font_objects)
+  {
+    Val found = loaded.find(i.first);
+    if(found == loaded.cend())
+      return false;
+
+    i.second = found->second.second;
+    i.second.m_tex = found->second.first == c_no_atlas ? nullptr : textures[found->second.first];
+  }
+
+  return true;
+}
+
+void FontManager::saveCache(string const&filename, uint64 hash, unordered_map<string, Font> &fonts)const
+{
+  vector<GLtex2d const*> atlases;
+  Val atlas_of = [&](Font const&f){
+    if(!f.m_tex)
+      return uint(c_no_atlas);
+
+    Val tex = f.m_tex.get();
+    Val found = std::find(atlases.cbegin(), atlases.cend(), tex);
+    if(found != atlases.cend())
+      return cast<uint>(found - atlases.cbegin());
+
+    atlases.emplace_back(tex);
+    return cast<uint>(atlases.size() - 1);
+  };
+
+  FlatOutputArchive a;
+  vector<uint> indices;
+  for(Val i: fonts)
+    indices.emplace_back(atlas_of(i.second));
+
+  a(uint(c_cache_magic), uint(c_cache_version), hash, cast<uint>(fonts.size()), cast<uint>(atlases.size()));
+  auto index = indices.cbegin();
+  for(auto &i: fonts)
+  {
+    a(i.first, *index++);
+    i.second.serialize(a);
+  }
+
+  for(Val tex: atlases)
+  {
+    Val channels = tex->stats().channels;
+    Val pixels = GLbind(*tex).Save<ubyte>(channels);
+    vector<char> raw(pixels.cbegin(), pixels.cend());
+    Val archive = Compression::Compress(raw);
+    Val compressed = archive.data.size() < raw.size() / 4 * 3;
+    Val atlas = compressed ? archive.data : raw;
+
+    a(tex->width(), tex->height(), channels, uint(compressed), uint64(atlas.size()));
+    a.append(atlas.data(), atlas.size());
+  }
+
+  Resource::Save(filename, a.data);
+}
+
+void FontManager::LoadRegisteredFonts(bool cache)
+{
+  uint64 hash = fnv1a(uint(c_cache_version), fnv1a(uvec4(c_glyph_size, c_border_size, c_supersample_mult, c_msdf_glyph_size), 14695981039346656037ull));
+  hash = fnv1a(sdf_backend, hash);
+  unordered_map<string, vector<char>> files;
+  map<string, string> sdf_fonts, msdf_fonts;
+  for(Val i: m_font_descriptions)
+  {
+    Val msdf = m_msdf_fonts.count(i.first) > 0;
+    auto &file = files[i.first];
+    file = Resource::Load(i.first);
+    hash = fnv1a(i.first.data(), i.first.size(), hash);
+    hash = fnv1a(file.data(), file.size(), hash);
+    hash = fnv1a(i.second.data(), i.second.size(), hash);
+    hash = fnv1a(msdf, hash);
+    (msdf ? msdf_fonts : sdf_fonts).emplace(i);
+  }
+
+  Val filename = [&]{
+    std::stringstream s;
+    s<<cache_dir<<"font_cache_"<<std::hex<<hash<<".bin";
+    return s.str();
+  }();
+
+  if(cache &&
+     loadCache(filename, hash))
+  {
+    for(auto &i: m_font_objects)
+      i.second.m_source = m_msdf_fonts.count(i.first) ? Font::MakeSource(move(files[i.first]), c_msdf_glyph_size, c_border_size, 1)
+                                                      : Font::MakeSource(move(files[i.first]), c_glyph_size, c_border_size, c_supersample_mult);
+    return;
+  }
+
+  unordered_map<string, Font> font_objects;
+  if(!sdf_fonts.empty())
+    font_objects = MakeFonts(sdf_fonts, c_glyph_size, c_border_size, c_supersample_mult, sdf_backend);
+  if(!msdf_fonts.empty())
+    for(auto &i: MakeFonts(msdf_fonts, c_msdf_glyph_size, c_border_size, 1, SdfBackend::Msdf))
+      font_objects.emplace(i.first, move(i.second));
+
   for(auto &i: m_font_objects)
   {
     Val found = font_objects.find(i.first);
@@ -94,13 +243,7 @@ void FontManager::LoadRegisteredFonts(bool cache)
     i.second = found->second;
   }
 
-  Val tex = font_objects.begin()->second.tex();
-  Resource::Save(c_t, ImageCodec::Encode(uImage{ tex.width(), tex.height(), 1, GLbind(tex).Save<ubyte>(1) }));
-
-  Val serialized = code_policy::serialize_into_vec(font_objects);
-  vector<char> data(reinterpret_cast<char const*>(&signature), reinterpret_cast<char const*>(&signature) + sizeof(size_t));
-  data.insert(data.cend(), serialized.cbegin(), serialized.cend());
-  Resource::Save(c_m, data);
+  saveCache(filename, hash, font_objects);
 }
 
 
@@ -13,7 +13,7 @@ inline vec4 to_rgba(uint c)
 
 struct Theme
 {
-  uint easing = 200;
+  uint easing = 200; //ms
 
   vec4 background = to_rgba(0x596475A0)
       , background_focus = to_rgba(0x596475A0)
@@ -75,12 +75,18 @@ private:
 
 struct FontManager
 {
-  Font const* Register(pair<string, string> font_description);
+  Font const* Register(pair<string, string> font_description, bool msdf=false);
   void LoadRegisteredFonts(bool cache=true);
 
+  SdfBackend sdf_backend = SdfBackend::PerGlyph;
+  string cache_dir = "resources/";
 private:
+  bool loadCache(string const&filename, uint64 hash);
+  void saveCache(string const&filename, uint64 hash, unordered_map<string, Font> &fonts)const;
+
   unordered_map<string, Font> m_font_objects;
   map<string, string> m_font_descriptions;
+  set<string> m_msdf_fonts;
 };
 
 
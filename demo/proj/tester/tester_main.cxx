@@ -6,12 +6,16 @@
 #include "gui/elements/button.h"
 #include "gui/elements/label.h"
 #include "gui/elements/selector.h"
+#include "gui/elements/stats_overlay.h"
+#include "gui/plot.h"
 
 //scene infrastructure and assorted sugar products
 #include "base_classes/texture_atlas.h"
 #include "base_classes/camera.h"
 #include "base_classes/utility/pbrt_envmap.h"
 #include "base_classes/utility/compute_shader.h"
+#include "base_classes/utility/text_loader.h"
+#include "base_classes/utility/half_float.h"
 #include "base_classes/policies/resource.h"
 #include "base_classes/policies/profiling.h"
 #include "base_classes/policies/id.h"
@@ -20,12 +24,31 @@
 #include "base_classes/policies/profiling.h"
 
 #include "glm/gtc/matrix_transform.hpp"
-#include <utfcpp/utf8.h>
 #include <GLFW/glfw3.h>
 #include <algorithm>
+#include <sstream>
 
 using namespace GUI;
 
+//label text showing a value, interned again only when the value changes
+template<class T>
+struct ValueText
+{
+  Interned const& operator()(String prefix, T const&value, String suffix="")
+  {
+    if(!m_text || value != m_value)
+    {
+      m_value = value;
+      m_text = Interned(prefix + std::to_string(value) + suffix);
+    }
+    return m_text;
+  }
+
+private:
+  T m_value = T();
+  Interned m_text;
+};
+
 int main()
 {
   //pretty self-explanatory. set window state and some basic gl caps
@@ -45,6 +68,8 @@ int main()
   //glyphs and textures are loaded in such manner since to fit atlas in the most efficient way we want to know sizes for all elements beforehand
   //should we want dynamic texture loading we would simply extend TextureManager through an adapter
   FontManager fonts;
+  //cold atlas generation runs the cpu distance transform over all glyphs on a thread pool instead of three gl passes and a readback per glyph
+  fonts.sdf_backend = SdfBackend::Cpu;
 
   //i automatically render sdf atlas from .ttf files and charsets since working with separate tool and then loading atlases is a bother
 
@@ -56,6 +81,8 @@ int main()
   //can't stress enough how much easier it makes reading the code, you gotta see how this looks on a screen with proper colors
   Val ascii_range = []{ string8 s; for(char i=32; i<127; ++i) s += i; return s; };
   Val default_font = fonts.Register({ "resources/UbuntuMono-R.ttf", ascii_range() + u8"ёйцукенгшщзхъфывапролджэячсмитьбюЁЙЦУКЕНГШЩЗХЪФЫВАПРОЛДЖЭЯЧСМИТЬБЮ" });
+  //a blank charset leaves a font with no atlas at all, everything it draws is loaded on demand into the glyph cache. fonts are keyed by path, hence the ./
+  Val cache_only_font = fonts.Register({ "resources/./UbuntuMono-R.ttf", " " });
   //btw sdf atlas is cached
   fonts.LoadRegisteredFonts();
 
@@ -107,12 +134,20 @@ int main()
   uint tooltip_timer = 0;
   //state for quitting and animating a spinner(on error, since it turned out there's no part of this app that would load anything with a noticeable delay, which would justify a worker thread)
   bool should_quit = false, running = true;
+  //F1 toggles the renderer statistics overlay. it is drawn last, so whatever it invalidates doesn't spill onto the rest of the scene
+  bool show_stats = false;
+  //recent frame times. the plot reduces them to min/max per pixel column; past 6000 samples the history is trimmed back to the last 600
+  PlotData frame_times;
+  auto frame_start = std::chrono::steady_clock::now();
 
   //a bunch of vars for the editor logic. all in all the editor is programmed in around 250 lines. the power of declarative approach
-  string selected_shader_file, saved_text, selected_model_file;
+  string selected_shader_file, selected_model_file;
+  uint64 saved_revision = 0;
   vector<string> shader_file_names, vertex_shaders, fragment_shaders;
-  map<string, string> shader_files = { { "shd_support.glsl", Resource::LoadText("shd_support.glsl") },
+  map<string, TextBuffer> shader_files = { { "shd_support.glsl", Resource::LoadText("shd_support.glsl") },
                                        { "shd_test.glsl",    Resource::LoadText("shd_test.glsl") } };
+  //files are mapped and show their first screen right away, the rest is indexed in the background. editor is readonly until then
+  unique_ptr<TextLoader> loading;
 
   //shader that is applied to the scene
   //you can change this by selecting vs and fs and pressing "run"
@@ -126,6 +161,12 @@ int main()
   //much more readable than const
   //this is what i'm talking about with Val
   Val model_file_names = vector<string>{ "resources/buddha.obj", "resources/bunny.obj", "resources/dragon.obj" };
+  //widgets compare their text by interned id, so constant captions are interned once up front
+  Val save_text = Interned("Save")
+      , run_text = Interned("Run")
+      , cache_only_text = Interned(u8"no atlas: ёж Wq");
+  ValueText<float> metallicity_text, roughness_text;
+  ValueText<uint> loading_text;
   Val text_edit = G::Get<TextEdit>(ID(TextEdit));
 
   //parses shaders and puts them into global shader text pool
@@ -134,7 +175,7 @@ int main()
   Val ParseSources = [&]{
     vertex_shaders.clear();
     fragment_shaders.clear();
-    for(auto &i: ParseShaderSources(text_edit.text))
+    for(auto &i: ParseShaderSources(text_edit.text.str()))
     {
       Val prefix = i.first.substr(0, 3);
       if(prefix == "vs_")
@@ -153,18 +194,17 @@ int main()
   Val LoadAction = [&](Val new_selection){
     auto& text_edit = G::Get<TextEdit>(ID(TextEdit));
     selected_shader_file = new_selection;
+    loading.reset();
 
     Val found = shader_files.find(new_selection);
     if(found != shader_files.cend())
       text_edit.text = found->second;
     else
     {
-      auto text = Resource::LoadText(new_selection);
-      if(!utf8::is_valid(text.cbegin(), text.cend()))
-        text = "";
-
-      text_edit.text = shader_files.emplace(new_selection, text).first->second;
-      saved_text = move(text);
+      loading = make_unique<TextLoader>(new_selection);
+      text_edit.text = loading->preview();
+      text_edit.write_history();
+      return;
     }
 
     text_edit.write_history();
@@ -175,16 +215,36 @@ int main()
     ParseSources();
   };
 
+  //swaps the preview for the whole file once it's indexed; invalid utf8 loads as empty
+  Val FinishLoad = [&]{
+    if(!loading || !loading->done())
+      return;
+
+    auto& text_edit = G::Get<TextEdit>(ID(TextEdit));
+    text_edit.text = shader_files.emplace(selected_shader_file, loading->result()).first->second;
+    saved_revision = text_edit.text.revision();
+    loading.reset();
+
+    text_edit.write_history();
+
+    shader_file_names.clear();
+    std::transform(shader_files.cbegin(), shader_files.cend(), std::back_inserter(shader_file_names), [](Val v){ return v.first; });
+
+    ParseSources();
+  };
+
   //self-explanatory
   Val SaveAction = [&]{
-    if(saved_text != text_edit.text)
+    if(!loading &&
+       saved_revision != text_edit.text.revision())
     {
-      saved_text = text_edit.text;
+      saved_revision = text_edit.text.revision();
 
       ParseSources();
 
-      vector<char> str(saved_text.cbegin(), saved_text.cend());
-      Resource::Save(selected_shader_file, str);
+      Val text = text_edit.text.str();
+      Resource::Save(selected_shader_file, vector<char>(text.cbegin(), text.cend()));
+      shader_files[selected_shader_file] = text_edit.text;
     }
   };
 
@@ -195,7 +255,9 @@ int main()
     ParseSources();
 
     bool valid;
-    GLshader new_shader(valid, error_log, selected_vs, selected_ps);
+    string log;
+    GLshader new_shader(valid, log, selected_vs, selected_ps);
+    error_log = log;
     if(valid)
     {
       running = true;
@@ -203,6 +265,57 @@ int main()
     }
   };
 
+  //F2 benchmarks vertex generation: the half conversion kernel alone, then Text::genMesh end to end over the opened file, scalar against the simd kernel
+  //numbers go to the log. quads are rebuilt from scratch every time, as they are when a text moves to a new batch
+  Val BenchMesh = [&]{
+    Val seconds = [](auto f){
+      double best = 1e9;
+      for(uint i=0; i<10; ++i)
+      {
+        Val start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+      }
+      return best;
+    };
+
+    vector<Text> texts;
+    uint verts = 0;
+    std::istringstream lines(text_edit.text.str());
+    for(string line; texts.size() < 400 && std::getline(lines, line);)
+    {
+      texts.emplace_back(Text::Make(0, vec2(-1, 0), line, default_font, 0.05));
+      verts += texts.back().vert_count();
+    }
+    if(!verts)
+      return;
+
+    vector<uint16> xyzw(verts * 4), uv(verts * 2);
+    vector<ubyte> rgba(verts * 4);
+    vector<float> floats(verts * 6, 0.3f);
+
+    Val active = ActiveHalfKernel();
+    for(Val k: { HalfKernel::Scalar, active })
+    {
+      ForceHalfKernel(k);
+      Val pack = seconds([&]{ for(uint i=0; i<100; ++i) PackHalf(floats.data(), xyzw.data(), floats.size()); }) / 100;
+      Val mesh = seconds([&]{
+        for(uint i=0; i<100; ++i)
+        {
+          uint at = 0;
+          for(Val t: texts)
+          {
+            t.genMesh(0.5, State::full, xyzw.begin() + at * 4, rgba.begin() + at * 4, uv.begin() + at * 2);
+            at += t.vert_count();
+          }
+        }
+      }) / 100;
+
+      CINFO("genMesh kernel "<<uint(k)<<": pack "<<pack / floats.size() * 1e9<<" ns/value, text "<<mesh / (verts / 4) * 1e9<<" ns/glyph over "<<verts / 4<<" glyphs");
+    }
+    ForceHalfKernel(active);
+  };
+
   //scene objects and settings for demo itself
   Val render_cube = GLshader("vs_skybox", "ps_skybox");
   Val sky = Skybox(1);
@@ -233,8 +346,21 @@ int main()
       Val metallicity = G::Draw<HorizontalSlider>(ID(metallicity), vec2(0.3, -0.88), vec2(1, 0.05), 0.05).bar
           , roughness = G::Draw<HorizontalSlider>(ID(roughness), vec2(0.3, -0.94), vec2(1, 0.05), 0.05).bar;
 
-      G::Draw<Label>(ID(met_count), vec2(1.31, -0.88), vec2(0.3, 0.05), "metallicity :" + std::to_string(metallicity));
-      G::Draw<Label>(ID(rou_count), vec2(1.31, -0.94), vec2(0.3, 0.05), "roughness :" + std::to_string(roughness));
+      G::Draw<Label>(ID(met_count), vec2(1.31, -0.88), vec2(0.3, 0.05), metallicity_text("metallicity :", metallicity));
+      G::Draw<Label>(ID(rou_count), vec2(1.31, -0.94), vec2(0.3, 0.05), roughness_text("roughness :", roughness));
+      G::Draw<Label>(ID(keys_help), vec2(1.31, -0.6), vec2(0.3, 0.1), string8("F2 benchmarks text mesh generation with every half float kernel, results go to the log"), 0.025f);
+
+      Val frame_end = std::chrono::steady_clock::now();
+      frame_times.Append({ std::chrono::duration<float, std::milli>(frame_end - frame_start).count() });
+      frame_start = frame_end;
+      if(frame_times.size() > 6000)
+        frame_times.Trim(600);
+      frame_times.view = { glm::max(0., double(frame_times.size()) - 600), 600, 0, 33 };
+      base.Clip(vec2(1.31, -0.76), vec2(0.3, 0.1));
+      base.Draw<Plot>(vec2(1.31, -0.76), vec2(0.3, 0.1), &frame_times, vec4(0.2, 0.8, 0.3, 1));
+
+      base.Clip(vec2(1.31, -0.66), vec2(0.3, 0.05));
+      base.Draw<Text>(vec2(1.31, -0.66), cache_only_text, cache_only_font, 0.04, vec4(1));
 
       Val model_selected = G::Draw<Selector>(ID(Selector_Model), vec2(1.31, -0.82), vec2(0.3, 0.05), model_file_names).text;
       if(model_selected != selected_model_file)
@@ -324,7 +450,7 @@ int main()
           {
             ++tooltip_timer;
             if(tooltip_timer > 60)
-              G::Draw<Label>(ID(Tooltip), p + size * vec2(0.05), size * vec2(message.length() * 0.03, 0.05), message);
+              G::Draw<Label>(ID(Tooltip), p + size * vec2(0.05), size * vec2(message.length() * 0.03, 0.05), Interned(message));
           }
         };
 
@@ -332,7 +458,8 @@ int main()
         //can gtk or qt textbox handle millons of lines of text?
         //is it implemented in 500 loc?
         //this is the power of functional programming
-        G::Draw<TextEdit>(ID(TextEdit), pos + size * vec2(0, button_h + padding * 2), size * vec2(1, 1. - (button_h + padding * 2)), 0.05);
+        FinishLoad();
+        G::Draw<TextEdit>(ID(TextEdit), pos + size * vec2(0, button_h + padding * 2), size * vec2(1, 1. - (button_h + padding * 2)), 0.05, bool(loading));
         if(!error_log.empty())
         {
           running = false;
@@ -343,7 +470,7 @@ int main()
         Val button_size = size * vec2(button_w, button_h);
 
         Val save_button_pos = pos + size * vec2(padding);
-        Val save_button = G::Draw<Button>(ID(Save), save_button_pos, button_size, "Save");
+        Val save_button = G::Draw<Button>(ID(Save), save_button_pos, button_size, save_text);
         ShowTooltip(save_button.hovered && !save_button.pressed, save_button_pos, "Ctrl + s");
 
         if(save_button.pressed)
@@ -367,12 +494,15 @@ int main()
 
 
         Val run_button_pos = pos + size * vec2(button_w * 4 + padding * 9, padding);
-        Val run_button = G::Draw<Button>(ID(Run), run_button_pos, button_size, "Run");
+        Val run_button = G::Draw<Button>(ID(Run), run_button_pos, button_size, run_text);
         ShowTooltip(run_button.hovered && !run_button.pressed, run_button_pos, "Ctrl + r");
 
         if(run_button.pressed)
           RunAction();
 
+        if(loading)
+          G::Draw<Label>(ID(Loading), pos + size * vec2(button_w * 5 + padding * 11, padding), button_size, loading_text("loading ", cast<uint>(loading->progress() * 100), "%"));
+
         //on errror show the spinning thingie, we can do animations unlike dear imgui!
         if(running)
           return;
@@ -387,6 +517,11 @@ int main()
       tooltip_timer = tooltip_timer == last_tooltip_timer ? 0u : tooltip_timer;
     }
 
+    //renderer publishes what happened to its caches last frame; the overlay graphs cpu time per stage and how much of the scene got rebuilt
+    base.timing = base.gpu_timing = show_stats;
+    if(show_stats)
+      G::Draw<StatsOverlay>(ID(Stats), vec2(-1, 0.6), vec2(1.2, 0.4));
+
     {
       //process whichever events weren't claimed by drawn elements
       CAUTOTIMER(events);
@@ -398,6 +533,8 @@ int main()
             switch(e.key().c)
             {
               case GLFW_KEY_ESCAPE: should_quit = true; break;
+              case GLFW_KEY_F1: if(e.key().s & Event::State::Press) show_stats = !show_stats; break;
+              case GLFW_KEY_F2: if(e.key().s & Event::State::Press) BenchMesh(); break;
               case GLFW_KEY_S: if(e.key().s & Event::State::Ctrl) SaveAction(); break;
               case GLFW_KEY_R: if(e.key().s & Event::State::Ctrl) RunAction(); break;
             }